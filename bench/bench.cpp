@@ -0,0 +1,458 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <order_book.h>
+#include <order.h>
+#include <result_sink.h>
+#include <symbol_table.h>
+#include <simple_cross.h>
+#include "workload.h"
+
+struct Config {
+  uint64_t seed = 42;
+  size_t symbols = 8;
+  size_t orders = 200000;
+  size_t depth = 10;
+  std::string filter;
+};
+
+using bench_clock = std::chrono::steady_clock;
+
+/**
+ * Collects one latency sample per timed operation. Setup between calls to
+ * time() isn't counted, so throughput is operations over the time spent
+ * inside them, timer overhead included (see the calibration line).
+*/
+class Recorder
+{
+ public:
+  explicit Recorder(size_t n) { samples_.reserve(n); }
+
+  template <typename F>
+  void time(F&& op)
+  {
+    auto start = bench_clock::now();
+    op();
+    auto end = bench_clock::now();
+    samples_.push_back(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count()));
+  }
+
+  /**
+   * Times n operations done in one go by op, and counts each of them at
+   * their share of the time.
+  */
+  template <typename F>
+  void time_batch(size_t n, F&& op)
+  {
+    auto start = bench_clock::now();
+    op();
+    auto end = bench_clock::now();
+    auto total = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count());
+    for (size_t i = 0; i < n; ++i) {
+      samples_.push_back(total / n);
+    }
+  }
+
+  void report(std::string_view name)
+  {
+    std::sort(samples_.begin(), samples_.end());
+    uint64_t total = 0;
+    for (auto sample : samples_) {
+      total += sample;
+    }
+    double ops_per_sec =
+        total ? static_cast<double>(samples_.size()) * 1e9 /
+                    static_cast<double>(total)
+              : 0.0;
+    std::printf("%-28.*s %10zu %12.0f %8llu %8llu %8llu\n",
+                static_cast<int>(name.size()), name.data(), samples_.size(),
+                ops_per_sec,
+                static_cast<unsigned long long>(percentile(0.50)),
+                static_cast<unsigned long long>(percentile(0.99)),
+                static_cast<unsigned long long>(percentile(0.999)));
+  }
+
+ private:
+  /**
+   * Nearest rank, samples_ must be sorted.
+  */
+  uint64_t percentile(double p) const
+  {
+    if (samples_.empty()) {
+      return 0;
+    }
+    auto rank = static_cast<size_t>(
+        std::ceil(p * static_cast<double>(samples_.size())));
+    return samples_[std::clamp<size_t>(rank, 1, samples_.size()) - 1];
+  }
+
+  std::vector<uint64_t> samples_;
+};
+
+static order::Order to_order(const bench::OrderSpec& spec)
+{
+  return order::Order{spec.oid, spec.symbol, spec.side, spec.qty, spec.price};
+}
+
+using books_t = std::vector<std::unique_ptr<order::OrderBook>>;
+
+static books_t make_books(size_t n)
+{
+  books_t books;
+  for (size_t i = 0; i < n; ++i) {
+    books.push_back(std::make_unique<order::OrderBook>());
+  }
+  return books;
+}
+
+// Keeps results that are otherwise unused from being optimized away.
+static volatile size_t sink_bytes = 0;
+
+static void bench_clock_overhead(const Config& config, Recorder* rec)
+{
+  for (size_t i = 0; i < config.orders; ++i) {
+    rec->time([] {});
+  }
+}
+
+/**
+ * Nothing ever crosses, every order is pushed onto a level.
+*/
+static void bench_place_resting(const Config& config, Recorder* rec)
+{
+  bench::Workload workload(config.seed, config.symbols);
+  auto books = make_books(config.symbols);
+  order::OrderResult result;
+  for (size_t i = 0; i < config.orders; ++i) {
+    auto order = to_order(workload.next_resting_order());
+    result.clear();
+    rec->time([&] {
+      books[order.symbol]->place_order(&order, &result);
+    });
+  }
+}
+
+/**
+ * The gen_actions.py stream, a mix of resting orders and fills.
+*/
+static void bench_place_crossing(const Config& config, Recorder* rec)
+{
+  bench::Workload workload(config.seed, config.symbols);
+  auto books = make_books(config.symbols);
+  order::OrderResult result;
+  for (size_t i = 0; i < config.orders; ++i) {
+    auto order = to_order(workload.next_order());
+    result.clear();
+    rec->time([&] {
+      books[order.symbol]->place_order(&order, &result);
+    });
+  }
+}
+
+/**
+ * Untimed, depth resting sells go onto one book, then a single buy takes
+ * all of them out, one level after the other.
+*/
+static void bench_place_sweep(const Config& config, Recorder* rec)
+{
+  bench::Workload workload(config.seed, 1);
+  order::OrderBook book;
+  order::OrderResult result;
+  for (size_t i = 0; i < config.orders; ++i) {
+    order::price_t top = 0;
+    for (size_t level = 0; level < config.depth; ++level) {
+      auto spec = workload.next_resting_order();
+      spec.side = order::OrderSide::kSell;
+      spec.qty = 1;
+      // Every sell on a level of its own.
+      spec.price =
+          workload.mean_price(0) + 1 + static_cast<order::price_t>(level);
+      auto sell = to_order(spec);
+      result.clear();
+      book.place_order(&sell, &result);
+      top = std::max(top, sell.price);
+    }
+    auto spec = workload.next_order();
+    spec.side = order::OrderSide::kBuy;
+    spec.qty = static_cast<order::qty_t>(config.depth);
+    spec.price = top;
+    auto buy = to_order(spec);
+    result.clear();
+    rec->time([&] { book.place_order(&buy, &result); });
+  }
+}
+
+/**
+ * Cancels every resting order of a populated BookMap in a random order.
+*/
+static void bench_cancel(const Config& config, Recorder* rec)
+{
+  bench::Workload workload(config.seed, config.symbols);
+  order::BookMap books;
+  for (const auto& name : workload.symbols()) {
+    books.symbols().intern(name);
+  }
+  order::OrderResult result;
+  std::vector<order::oid_t> oids;
+  for (size_t i = 0; i < config.orders; ++i) {
+    auto order = to_order(workload.next_resting_order());
+    books.handle_order(&order, &result);
+    oids.push_back(order.oid);
+  }
+  // Fisher-Yates off of the workload so it's the same everywhere.
+  for (size_t i = oids.size(); i > 1; --i) {
+    std::swap(oids[i - 1], oids[workload.uniform(i)]);
+  }
+  for (auto oid : oids) {
+    rec->time([&] { books.cancel_order(oid, &result); });
+  }
+}
+
+/**
+ * The gen_actions.py stream with a cancel of a random earlier order after
+ * every two orders, in bursts of kBurst requests.
+*/
+static constexpr size_t kBurst = 256;
+
+static std::vector<order::BookRequest> make_requests(const Config& config,
+                                                     order::BookMap* books)
+{
+  bench::Workload workload(config.seed, config.symbols);
+  for (const auto& name : workload.symbols()) {
+    books->symbols().intern(name);
+  }
+  std::vector<order::BookRequest> requests;
+  while (requests.size() < config.orders) {
+    auto order = to_order(workload.next_order());
+    requests.push_back(order::BookRequest{order, false});
+    if (order.oid % 2 == 1) {
+      order::BookRequest cancel;
+      cancel.order.oid = static_cast<order::oid_t>(workload.uniform(order.oid));
+      cancel.cancel = true;
+      requests.push_back(cancel);
+    }
+  }
+  requests.resize(config.orders);
+  return requests;
+}
+
+static void bench_book_map_per_call(const Config& config, Recorder* rec)
+{
+  order::BookMap books;
+  auto requests = make_requests(config, &books);
+  order::OrderResult result;
+  result.fills.reserve(order::kReservedFills);
+  for (size_t begin = 0; begin < requests.size(); begin += kBurst) {
+    auto n = std::min(kBurst, requests.size() - begin);
+    rec->time_batch(n, [&] {
+      for (size_t i = begin; i < begin + n; ++i) {
+        auto order = requests[i].order;
+        if (requests[i].cancel) {
+          books.cancel_order(order.oid, &result);
+        } else {
+          books.handle_order(&order, &result);
+        }
+        sink_bytes = sink_bytes + result.fills.size();
+      }
+    });
+  }
+}
+
+static void bench_book_map_batch(const Config& config, Recorder* rec)
+{
+  order::BookMap books;
+  auto requests = make_requests(config, &books);
+  order::BatchResult out;
+  out.fills.reserve(order::kReservedFills);
+  for (size_t begin = 0; begin < requests.size(); begin += kBurst) {
+    auto n = std::min(kBurst, requests.size() - begin);
+    rec->time_batch(n, [&] {
+      books.handle_batch(
+          std::span<const order::BookRequest>(&requests[begin], n), &out);
+      sink_bytes = sink_bytes + out.fills.size();
+    });
+  }
+}
+
+static void bench_deserialize(const Config& config, Recorder* rec)
+{
+  bench::Workload workload(config.seed, config.symbols);
+  std::vector<std::string> lines;
+  for (size_t i = 0; i < config.orders; ++i) {
+    lines.push_back(workload.line(workload.next_order()));
+  }
+  order::SymbolTable symbols;
+  results_t err;
+  for (const auto& line : lines) {
+    err.clear();
+    rec->time([&] {
+      auto action = deserialize_action(line, &err, &symbols);
+      sink_bytes = sink_bytes + action.index();
+    });
+  }
+}
+
+/**
+ * The symbol look-up every parsed order does, all of the symbols already
+ * interned.
+*/
+static void bench_symbol_intern(const Config& config, Recorder* rec)
+{
+  bench::Workload workload(config.seed, config.symbols);
+  order::SymbolTable symbols;
+  for (const auto& name : workload.symbols()) {
+    symbols.intern(name);
+  }
+  for (size_t i = 0; i < config.orders; ++i) {
+    const auto& name = workload.symbols()[workload.next_order().symbol];
+    rec->time([&] { sink_bytes = sink_bytes + symbols.intern(name); });
+  }
+}
+
+static void bench_order_str(const Config& config, Recorder* rec)
+{
+  bench::Workload workload(config.seed, config.symbols);
+  for (size_t i = 0; i < config.orders; ++i) {
+    auto order = to_order(workload.next_order());
+    const auto& symbol = workload.symbols()[order.symbol];
+    rec->time([&] {
+      auto text = order.str(symbol, 'P');
+      sink_bytes = sink_bytes + text.size();
+    });
+  }
+}
+
+/**
+ * What P and fills actually go through, formatting into an OutputBuffer.
+*/
+static void bench_buffer_sink(const Config& config, Recorder* rec)
+{
+  bench::Workload workload(config.seed, config.symbols);
+  order::OutputBuffer out;
+  order::BufferSink sink(&out);
+  for (size_t i = 0; i < config.orders; ++i) {
+    auto order = to_order(workload.next_order());
+    const auto& symbol = workload.symbols()[order.symbol];
+    rec->time([&] { sink.book_order(order, symbol); });
+    sink_bytes = sink_bytes + out.view().size();
+    out.clear();
+  }
+}
+
+/**
+ * Whole lines through parsing, matching, and formatting the results.
+*/
+static void bench_simple_cross(const Config& config, Recorder* rec)
+{
+  bench::Workload workload(config.seed, config.symbols);
+  std::vector<std::string> lines;
+  for (size_t i = 0; i < config.orders; ++i) {
+    lines.push_back(workload.line(workload.next_order()));
+  }
+  order::OutputBuffer out;
+  order::BufferSink sink(&out);
+  SimpleCross scross;
+  for (const auto& line : lines) {
+    rec->time([&] { scross.action(line, &sink); });
+    sink_bytes = sink_bytes + out.view().size();
+    out.clear();
+  }
+}
+
+struct Benchmark {
+  std::string_view name;
+  std::function<void(const Config&, Recorder*)> run;
+};
+
+static void usage(const char* argv0)
+{
+  std::cerr << "usage: " << argv0
+            << " [--seed N] [--symbols N] [--orders N] [--depth N] "
+               "[FILTER]\n"
+            << "  Runs every benchmark whose name contains FILTER, each "
+               "over --orders\n"
+            << "  operations of a workload generated from --seed, and "
+               "prints throughput\n"
+            << "  and p50/p99/p99.9 latency. The same arguments replay "
+               "the same workload.\n"
+            << "  --symbols  books in the workload (default: 8)\n"
+            << "  --depth    levels each place_order/sweep takes out "
+               "(default: 10)\n";
+}
+
+static bool parse_size(std::string_view arg, uint64_t* value)
+{
+  auto [end, ec] =
+      std::from_chars(arg.data(), arg.data() + arg.size(), *value);
+  return ec == std::errc() && end == arg.data() + arg.size() && *value > 0;
+}
+
+int main(int argc, char* argv[])
+{
+  Config config;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg(argv[i]);
+    uint64_t value = 0;
+    bool has_value = (i + 1 < argc) && parse_size(argv[i + 1], &value);
+    if (arg == "--seed" && has_value) {
+      config.seed = value;
+    } else if (arg == "--symbols" && has_value) {
+      config.symbols = value;
+    } else if (arg == "--orders" && has_value) {
+      config.orders = value;
+    } else if (arg == "--depth" && has_value && value <= 1000) {
+      config.depth = value;
+    } else if (arg.size() > 1 && arg.front() == '-') {
+      usage(argv[0]);
+      return (arg == "-h" || arg == "--help") ? 0 : 1;
+    } else {
+      config.filter = arg;
+      continue;
+    }
+    ++i;
+  }
+
+  const Benchmark benchmarks[] = {
+      {"clock_overhead", bench_clock_overhead},
+      {"place_order/resting", bench_place_resting},
+      {"place_order/crossing", bench_place_crossing},
+      {"place_order/sweep", bench_place_sweep},
+      {"cancel_order", bench_cancel},
+      {"book_map/per_call", bench_book_map_per_call},
+      {"book_map/batch", bench_book_map_batch},
+      {"deserialize_action", bench_deserialize},
+      {"symbol_table/intern", bench_symbol_intern},
+      {"order_str", bench_order_str},
+      {"buffer_sink/book_order", bench_buffer_sink},
+      {"simple_cross/action", bench_simple_cross},
+  };
+  std::printf("seed %llu, symbols %zu, orders %zu, depth %zu\n",
+              static_cast<unsigned long long>(config.seed), config.symbols,
+              config.orders, config.depth);
+  std::printf("%-28s %10s %12s %8s %8s %8s\n", "benchmark", "ops", "ops/s",
+              "p50 ns", "p99 ns", "p99.9 ns");
+  for (const auto& benchmark : benchmarks) {
+    if (benchmark.name.find(config.filter) == std::string_view::npos) {
+      continue;
+    }
+    Recorder rec(config.orders);
+    benchmark.run(config, &rec);
+    rec.report(benchmark.name);
+  }
+  return 0;
+}
@@ -0,0 +1,95 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <order.h>
+#include "workload.h"
+
+namespace bench
+{
+
+constexpr double kPriceMu = 42.0;
+constexpr double kPriceSigma = 8.0;
+constexpr double kPerSymbolSigma = 0.25;
+constexpr size_t kSymbolSize = 8;
+constexpr uint64_t kQtyMax = 0x10000 - 1;
+
+Workload::Workload(uint64_t seed, size_t num_symbols) : gen_(seed)
+{
+  for (size_t i = 0; i < num_symbols; ++i) {
+    std::string symbol;
+    for (size_t c = 0; c < kSymbolSize; ++c) {
+      symbol.push_back(static_cast<char>('A' + uniform(26)));
+    }
+    double mean = 0.0;
+    while (mean <= 0.0) {
+      mean = normal(kPriceMu, kPriceSigma);
+    }
+    symbols_.push_back(symbol);
+    means_.push_back(mean);
+    mean_prices_.push_back(to_ticks(mean));
+  }
+}
+
+uint64_t Workload::uniform(uint64_t bound)
+{
+  // Rejects the top partial range so that every value is equally likely.
+  const uint64_t threshold = (0 - bound) % bound;
+  while (true) {
+    auto r = gen_();
+    if (r >= threshold) {
+      return r % bound;
+    }
+  }
+}
+
+double Workload::normal(double mu, double sigma)
+{
+  constexpr double kUnit = 1.0 / static_cast<double>(uint64_t{1} << 53);
+  constexpr double kTwoPi = 6.283185307179586;
+  // u1 in (0, 1] so the log is finite.
+  double u1 = static_cast<double>((gen_() >> 11) + 1) * kUnit;
+  double u2 = static_cast<double>(gen_() >> 11) * kUnit;
+  return mu + sigma * std::sqrt(-2.0 * std::log(u1)) * std::cos(kTwoPi * u2);
+}
+
+order::price_t Workload::to_ticks(double price) const
+{
+  auto ticks = std::llround(price * static_cast<double>(order::kPriceScale));
+  return (ticks < 1) ? 1 : ticks;
+}
+
+OrderSpec Workload::next_order()
+{
+  OrderSpec spec;
+  spec.oid = next_oid_++;
+  spec.symbol = static_cast<uint32_t>(uniform(symbols_.size()));
+  spec.side = uniform(2) ? order::OrderSide::kSell : order::OrderSide::kBuy;
+  spec.qty = static_cast<order::qty_t>(1 + uniform(kQtyMax - 1));
+  spec.price = to_ticks(normal(means_[spec.symbol], kPerSymbolSigma));
+  return spec;
+}
+
+OrderSpec Workload::next_resting_order()
+{
+  auto spec = next_order();
+  auto mean = mean_prices_[spec.symbol];
+  auto away = (spec.price > mean) ? spec.price - mean : mean - spec.price;
+  if (spec.side == order::OrderSide::kBuy) {
+    spec.price = (mean - 1 - away < 1) ? 1 : mean - 1 - away;
+  } else {
+    spec.price = mean + 1 + away;
+  }
+  return spec;
+}
+
+std::string Workload::line(const OrderSpec& spec) const
+{
+  auto decimals = std::to_string(spec.price % order::kPriceScale);
+  decimals.insert(0, order::kPriceDecimals - decimals.size(), '0');
+  return "O " + std::to_string(spec.oid) + " " + symbols_[spec.symbol] + " " +
+         static_cast<char>(spec.side) + " " + std::to_string(spec.qty) + " " +
+         std::to_string(spec.price / order::kPriceScale) + "." + decimals;
+}
+
+}  // namespace bench
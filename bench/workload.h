@@ -0,0 +1,87 @@
+#ifndef BENCH_WORKLOAD_H_
+#define BENCH_WORKLOAD_H_
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include <order.h>
+
+namespace bench
+{
+
+/**
+ * One generated order, symbol is an index into Workload::symbols(), not a
+ * SymbolTable id.
+*/
+struct OrderSpec {
+  order::oid_t oid;
+  uint32_t symbol;
+  order::OrderSide side;
+  order::qty_t qty;
+  order::price_t price;
+};
+
+/**
+ * Seeded C++ take on test/gen_actions.py: num_symbols random 8 letter
+ * symbols, each with a mean price drawn from N(42, 8), and orders that
+ * pick a symbol, a side, and a qty uniformly and a price from
+ * N(symbol mean, 0.25). OIDs count up from 0.
+ *
+ * std::uniform_int_distribution and std::normal_distribution are
+ * implementation defined, so the draws are done by hand on top of
+ * std::mt19937_64 (whose output is not): the same seed gives the same
+ * workload with libstdc++ and libc++.
+*/
+class Workload
+{
+ public:
+  Workload(uint64_t seed, size_t num_symbols);
+
+  /**
+   * Next order of the stream, like gen_actions.py's create_action. About
+   * half of them cross the touch of their symbol's book.
+  */
+  OrderSpec next_order();
+  /**
+   * Same as above, but buys are reflected below the symbol's mean price and
+   * sells above it, so no two of them ever cross.
+  */
+  OrderSpec next_resting_order();
+
+  /**
+   * The "O <oid> <symbol> <side> <qty> <price>" line for order.
+  */
+  std::string line(const OrderSpec& order) const;
+
+  const std::vector<std::string>& symbols() const noexcept
+  {
+    return symbols_;
+  }
+  order::price_t mean_price(uint32_t symbol) const
+  {
+    return mean_prices_[symbol];
+  }
+
+  /**
+   * Uniform in [0, bound).
+  */
+  uint64_t uniform(uint64_t bound);
+  /**
+   * Box-Muller.
+  */
+  double normal(double mu, double sigma);
+
+ private:
+  order::price_t to_ticks(double price) const;
+
+  std::mt19937_64 gen_;
+  std::vector<std::string> symbols_;
+  std::vector<double> means_;
+  std::vector<order::price_t> mean_prices_;
+  order::oid_t next_oid_ = 0;
+};
+
+}  // namespace bench
+
+#endif  // BENCH_WORKLOAD_H_
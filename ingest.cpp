@@ -0,0 +1,160 @@
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ingest.h"
+
+namespace ingest
+{
+
+constexpr size_t kBatchLines = 4096;
+constexpr size_t kBlockSize = size_t{1} << 20;
+
+/**
+ * Looks for a whole record at the front of [start, start + remaining).
+ * Returns false if there isn't one yet, otherwise its length and how many
+ * bytes it takes up (with the '\n').
+*/
+static bool next_record(const char* start, size_t remaining,
+                        size_t record_size, size_t* len, size_t* consumed)
+{
+  if (record_size != 0) {
+    if (remaining < record_size) {
+      return false;
+    }
+    *len = *consumed = record_size;
+    return true;
+  }
+  const auto* newline =
+      static_cast<const char*>(std::memchr(start, '\n', remaining));
+  if (newline == nullptr) {
+    return false;
+  }
+  *len = static_cast<size_t>(newline - start);
+  *consumed = *len + 1;
+  return true;
+}
+
+MappedFileSource::MappedFileSource(const char* data, size_t size,
+                                   size_t record_size)
+    : data_(data), size_(size), record_size_(record_size)
+{
+}
+
+MappedFileSource::~MappedFileSource()
+{
+  ::munmap(const_cast<char*>(data_), size_);
+}
+
+bool MappedFileSource::next_batch(line_batch_t* batch)
+{
+  batch->clear();
+  while (pos_ < size_ && batch->size() < kBatchLines) {
+    const char* start = data_ + pos_;
+    size_t remaining = size_ - pos_;
+    size_t len, consumed;
+    if (!next_record(start, remaining, record_size_, &len, &consumed)) {
+      len = consumed = remaining;
+    }
+    batch->emplace_back(start, len);
+    pos_ += consumed;
+  }
+  return !batch->empty();
+}
+
+BlockReadSource::BlockReadSource(int fd, bool owns_fd, size_t record_size)
+    : fd_(fd),
+      owns_fd_(owns_fd),
+      record_size_(record_size),
+      buffer_(kBlockSize)
+{
+}
+
+BlockReadSource::~BlockReadSource()
+{
+  if (owns_fd_) {
+    ::close(fd_);
+  }
+}
+
+bool BlockReadSource::next_batch(line_batch_t* batch)
+{
+  batch->clear();
+  while (batch->size() < kBatchLines) {
+    char* start = buffer_.data() + begin_;
+    size_t remaining = end_ - begin_;
+    size_t len, consumed;
+    if (next_record(start, remaining, record_size_, &len, &consumed)) {
+      batch->emplace_back(start, len);
+      begin_ += consumed;
+      continue;
+    }
+    if (!batch->empty()) {
+      // Views into the buffer are out, the next call refills it.
+      break;
+    }
+    if (eof_) {
+      if (remaining > 0) {
+        batch->emplace_back(start, remaining);
+        begin_ = end_;
+      }
+      break;
+    }
+
+    // Keep the partial record, grow if it fills the whole buffer.
+    std::memmove(buffer_.data(), start, remaining);
+    begin_ = 0;
+    end_ = remaining;
+    if (end_ == buffer_.size()) {
+      buffer_.resize(buffer_.size() * 2);
+    }
+    ssize_t n;
+    do {
+      n = ::read(fd_, buffer_.data() + end_, buffer_.size() - end_);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+      // Whatever came before is still handed out, then nothing more.
+      error_ = std::strerror(errno);
+      eof_ = true;
+    } else if (n == 0) {
+      eof_ = true;
+    } else {
+      end_ += static_cast<size_t>(n);
+    }
+  }
+  return !batch->empty();
+}
+
+std::unique_ptr<LineSource> open_source(const std::string& path, Mode mode,
+                                        std::string* err, size_t record_size)
+{
+  bool from_stdin = (path == "-");
+  int fd = from_stdin ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    *err = path + ": " + std::strerror(errno);
+    return nullptr;
+  }
+  if (mode == Mode::kMmap) {
+    struct stat st {
+    };
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+      auto size = static_cast<size_t>(st.st_size);
+      void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        ::madvise(data, size, MADV_SEQUENTIAL);
+        if (!from_stdin) {
+          ::close(fd);
+        }
+        return std::make_unique<MappedFileSource>(static_cast<char*>(data),
+                                                  size, record_size);
+      }
+    }
+  }
+  return std::make_unique<BlockReadSource>(fd, !from_stdin, record_size);
+}
+
+}  // namespace ingest
@@ -0,0 +1,108 @@
+#ifndef INGEST_H_
+#define INGEST_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ingest
+{
+
+using line_batch_t = std::vector<std::string_view>;
+
+const extern size_t kBatchLines;
+const extern size_t kBlockSize;
+
+/**
+ * Hands out lines in batches of views into a buffer the source owns,
+ * split the way std::getline would split them (without the '\n').
+ * Sources built with a record_size hand out fixed-width records of that
+ * many bytes instead (and whatever is left over at the end).
+ * The views in a batch are only valid until the next call to next_batch.
+*/
+class LineSource
+{
+ public:
+  virtual ~LineSource() = default;
+
+  /**
+   * Replaces the contents of batch with up to kBatchLines lines.
+   * Returns false once there is nothing left to read, or it can't be read
+   * any more, see error().
+  */
+  virtual bool next_batch(line_batch_t* batch) = 0;
+
+  /**
+   * Why the input ended early, empty if it was read to the end.
+  */
+  const std::string& error() const noexcept { return error_; }
+
+ protected:
+  std::string error_;
+};
+
+/**
+ * Maps a whole file and hands out views straight into the mapping.
+*/
+class MappedFileSource : public LineSource
+{
+ public:
+  MappedFileSource(const char* data, size_t size, size_t record_size = 0);
+  ~MappedFileSource() override;
+  MappedFileSource(const MappedFileSource&) = delete;
+  MappedFileSource& operator=(const MappedFileSource&) = delete;
+
+  bool next_batch(line_batch_t* batch) override;
+
+ private:
+  const char* data_;
+  size_t size_;
+  size_t record_size_;
+  size_t pos_ = 0;
+};
+
+/**
+ * read(2)s a file descriptor kBlockSize bytes at a time, a line that
+ * straddles two blocks is moved to the front of the buffer before the next
+ * read (and the buffer grows if a single line doesn't fit in it).
+*/
+class BlockReadSource : public LineSource
+{
+ public:
+  explicit BlockReadSource(int fd, bool owns_fd = false,
+                           size_t record_size = 0);
+  ~BlockReadSource() override;
+  BlockReadSource(const BlockReadSource&) = delete;
+  BlockReadSource& operator=(const BlockReadSource&) = delete;
+
+  bool next_batch(line_batch_t* batch) override;
+
+ private:
+  int fd_;
+  bool owns_fd_;
+  size_t record_size_;
+  bool eof_ = false;
+  std::vector<char> buffer_;
+  size_t begin_ = 0;  // first byte not handed out yet
+  size_t end_ = 0;    // one past the last byte read
+};
+
+enum class Mode {
+  kMmap,
+  kRead,
+};
+
+/**
+ * Opens path ("-" for stdin) with the given mode. Anything that can't be
+ * mapped (stdin, pipes, empty files) falls back to kRead.
+ * Returns nullptr and fills err if the file can't be opened.
+*/
+std::unique_ptr<LineSource> open_source(const std::string& path, Mode mode,
+                                        std::string* err,
+                                        size_t record_size = 0);
+
+}  // namespace ingest
+
+#endif  // INGEST_H_
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <variant>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "journal.h"
+#include "wire.h"
+
+namespace journal
+{
+
+static int datasync(int fd)
+{
+#ifdef __APPLE__
+  return ::fsync(fd);
+#else
+  return ::fdatasync(fd);
+#endif
+}
+
+Journal::Journal(int fd, Sync sync, std::chrono::milliseconds interval,
+                 size_t records)
+    : fd_(fd), sync_(sync), interval_(interval), records_(records)
+{
+  if (sync_ != Sync::kInterval) {
+    return;
+  }
+  if (interval_.count() <= 0) {
+    // Nothing to wait for between fsyncs, that's every commit.
+    sync_ = Sync::kBatch;
+    return;
+  }
+  syncer_ = std::thread([this] { sync_loop(); });
+}
+
+std::unique_ptr<Journal> Journal::open(const std::string& path, Sync sync,
+                                       std::chrono::milliseconds interval,
+                                       std::string* err)
+{
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) {
+    *err = path + ": " + std::strerror(errno);
+    return nullptr;
+  }
+  struct stat st {
+  };
+  if (::fstat(fd, &st) != 0) {
+    *err = path + ": " + std::strerror(errno);
+    ::close(fd);
+    return nullptr;
+  }
+  auto torn = static_cast<size_t>(st.st_size) % wire::kMessageSize;
+  if (torn != 0 && ::ftruncate(fd, st.st_size - static_cast<off_t>(torn))) {
+    *err = path + ": " + std::strerror(errno);
+    ::close(fd);
+    return nullptr;
+  }
+  auto records = static_cast<size_t>(st.st_size) / wire::kMessageSize;
+  return std::unique_ptr<Journal>(new Journal(fd, sync, interval, records));
+}
+
+Journal::~Journal()
+{
+  if (syncer_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    stop_cv_.notify_one();
+    syncer_.join();
+  }
+  try {
+    commit();
+    if (sync_ != Sync::kNone && dirty_) {
+      sync();
+    }
+  } catch (const std::system_error&) {
+    // Nothing left to tell, commit() already failed once if it matters.
+  }
+  ::close(fd_);
+}
+
+void Journal::append(const Action& action, const order::SymbolTable& symbols)
+{
+  if (!std::holds_alternative<PlaceOrderAction>(action) &&
+      !std::holds_alternative<CancelOrderAction>(action)) {
+    return;
+  }
+  wire::Message msg;
+  if (!wire::encode_action(action, symbols, &msg)) {
+    return;
+  }
+  auto size = buffer_.size();
+  buffer_.resize(size + wire::kMessageSize);
+  wire::encode(msg, buffer_.data() + size);
+  ++records_;
+}
+
+void Journal::commit()
+{
+  if (auto error = sync_error_.exchange(0); error != 0) {
+    throw std::system_error(error, std::generic_category(), "journal sync");
+  }
+  size_t written = 0;
+  while (written < buffer_.size()) {
+    ssize_t n = ::write(fd_, buffer_.data() + written,
+                        buffer_.size() - written);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      auto error = errno;
+      // What made it is on file, only the rest may be retried.
+      buffer_.erase(0, written);
+      throw std::system_error(error, std::generic_category(),
+                              "journal write");
+    }
+    written += static_cast<size_t>(n);
+    dirty_.store(true, std::memory_order_release);
+  }
+  buffer_.clear();
+  if (sync_ == Sync::kBatch && dirty_.load(std::memory_order_acquire)) {
+    sync();
+  }
+}
+
+void Journal::sync()
+{
+  dirty_.store(false, std::memory_order_release);
+  int rc = datasync(fd_);
+  if (rc != 0) {
+    dirty_.store(true, std::memory_order_release);
+    throw std::system_error(errno, std::generic_category(), "journal sync");
+  }
+}
+
+/**
+ * dirty_ is cleared before the fsync, so a write that lands during one is
+ * either covered by it or left dirty for the next.
+*/
+void Journal::sync_loop()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_cv_.wait_for(lock, interval_, [this] { return stopping_; })) {
+    if (!dirty_.exchange(false, std::memory_order_acq_rel)) {
+      continue;
+    }
+    int rc = datasync(fd_);
+    if (rc != 0) {
+      sync_error_.store(errno);
+      dirty_.store(true, std::memory_order_release);
+    }
+  }
+}
+
+bool replay(const std::string& path,
+            const std::function<void(const ingest::line_batch_t&)>& apply,
+            uint64_t skip, size_t* records, std::string* err)
+{
+  *records = 0;
+  struct stat st {
+  };
+  if (::stat(path.c_str(), &st) != 0 && errno == ENOENT) {
+    if (skip == 0) {
+      return true;
+    }
+    *err = path + ": missing, the snapshot covers " + std::to_string(skip) +
+           " of its messages";
+    return false;
+  }
+  auto source =
+      ingest::open_source(path, ingest::Mode::kMmap, err, wire::kMessageSize);
+  if (!source) {
+    return false;
+  }
+  ingest::line_batch_t batch;
+  while (source->next_batch(&batch)) {
+    if (batch.back().size() != wire::kMessageSize) {
+      batch.pop_back();
+    }
+    auto skipped = static_cast<size_t>(std::min<uint64_t>(skip, batch.size()));
+    skip -= skipped;
+    batch.erase(batch.begin(),
+                batch.begin() + static_cast<std::ptrdiff_t>(skipped));
+    if (batch.empty()) {
+      continue;
+    }
+    *records += batch.size();
+    apply(batch);
+  }
+  if (skip != 0) {
+    *err = path + ": " + std::to_string(skip) +
+           " messages short of what the snapshot covers";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace journal
@@ -0,0 +1,125 @@
+#ifndef JOURNAL_H_
+#define JOURNAL_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <order.h>
+#include <symbol_table.h>
+#include "ingest.h"
+#include "simple_cross.h"
+
+namespace journal
+{
+
+/**
+ * When a commit is made durable.
+ *   kNone      never fsync, the page cache decides (survives a crash of
+ *              the process, not of the machine)
+ *   kBatch     fsync every commit
+ *   kInterval  a background thread fsyncs whatever was committed since
+ *              its last fsync once per interval, so a commit is durable
+ *              at most an interval later even if nothing else comes
+*/
+enum class Sync {
+  kNone,
+  kBatch,
+  kInterval,
+};
+
+/**
+ * Append-only write-ahead journal of the actions an engine accepted from
+ * its parser, every O and X in input order as a wire::Message. P doesn't
+ * change any book and isn't journaled. Matching is deterministic, so
+ * replaying the journal into empty books (see replay) rebuilds exactly the
+ * books that were there, rejected duplicates and cancel misses included.
+ * A journal is also a valid binary action file for --format binary.
+ *
+ * append() only copies the message into memory. commit() is the group
+ * commit: one write(2) for everything appended since the last one, and an
+ * fsync depending on Sync, so the engines commit once per batch and the
+ * matching loop never makes a syscall for the journal.
+ * Results only reach their output after the actions behind them are
+ * committed: the outputs call commit() as their write barrier (see
+ * OutputBuffer::set_write_barrier) whenever they fill up mid-batch.
+*/
+class Journal
+{
+ public:
+  /**
+   * Opens path for appending, creating it if needed. A partial message at
+   * the end (a torn write) is cut off first.
+   * Returns nullptr and fills err if the file can't be opened.
+  */
+  static std::unique_ptr<Journal> open(const std::string& path, Sync sync,
+                                       std::chrono::milliseconds interval,
+                                       std::string* err);
+  ~Journal();
+  Journal(const Journal&) = delete;
+  Journal& operator=(const Journal&) = delete;
+
+  /**
+   * Buffers action if it's an order or a cancel.
+  */
+  void append(const Action& action, const order::SymbolTable& symbols);
+  /**
+   * Writes out everything appended since the last commit and syncs it as
+   * configured. Throws std::system_error if the journal can't be written
+   * or a background fsync failed, the engine must not go on without it.
+   * Whatever a failed write left unwritten is kept for the next commit,
+   * nothing is ever written twice.
+  */
+  void commit();
+
+  /**
+   * Messages in the journal, the ones it held when it was opened
+   * included, committed or not.
+  */
+  size_t records() const noexcept { return records_; }
+
+ private:
+  Journal(int fd, Sync sync, std::chrono::milliseconds interval,
+          size_t records);
+  void sync();
+  /**
+   * kInterval's background thread.
+  */
+  void sync_loop();
+
+  int fd_;
+  Sync sync_;
+  std::chrono::milliseconds interval_;
+  // Written but not fsynced yet.
+  std::atomic<bool> dirty_{false};
+  // errno of a failed background fsync, thrown by the next commit.
+  std::atomic<int> sync_error_{0};
+  std::mutex mutex_;
+  std::condition_variable stop_cv_;
+  bool stopping_ = false;
+  std::thread syncer_;
+  std::string buffer_;
+  size_t records_ = 0;
+};
+
+/**
+ * Reads the journal at path and hands its whole messages past the first
+ * skip to apply in batches, a torn message at the end is skipped. A
+ * journal that doesn't exist yet is empty.
+ * Returns false and fills err if it can't be read or holds fewer than
+ * skip messages, otherwise sets *records to how many messages were handed
+ * to apply.
+*/
+bool replay(const std::string& path,
+            const std::function<void(const ingest::line_batch_t&)>& apply,
+            uint64_t skip, size_t* records, std::string* err);
+
+}  // namespace journal
+
+#endif  // JOURNAL_H_
@@ -1,29 +1,405 @@
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
 #include <string>
-#include <fstream>
+#include <string_view>
+#include <system_error>
 #include <iostream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <result_sink.h>
+#ifdef SC_STATS
+#include <csignal>
+#include <stats.h>
+#endif
+#include "ingest.h"
+#include "journal.h"
+#include "sharded_cross.h"
 #include "simple_cross.h"
+#include "wire.h"
 
-#if !defined(STDIN)
-#define WHILE_GETLINE(x)                              \
-  std::ifstream actions("actions.txt", std::ios::in); \
-  while (std::getline(actions, x))
-#else  // STDIN
-#define WHILE_GETLINE(x) while (std::getline(std::cin, x))
-#endif  // STDIN
+static void usage(const char *argv0)
+{
+  std::cerr << "usage: " << argv0
+            << " [--mmap | --read] [--format text|binary] [--shards N] "
+               "[--journal JOURNAL [--fsync none|batch|MS]]\n"
+            << "  [--load-snapshot SNAPSHOT] [--save-snapshot SNAPSHOT] "
+               "[--depth-feed FEED] [FILE]\n"
+            << "  Replays the actions in FILE, or stdin if FILE is - or "
+               "missing.\n"
+            << "  --mmap    map the input if it is a regular file (default)\n"
+            << "  --read    read the input in blocks\n"
+            << "  --format  text actions and results (default), or "
+               "wire::Message\n"
+            << "            encoded ones, see wire.h and sc_convert\n"
+            << "  --shards  match on N worker threads, books split by "
+               "symbol (1-"
+            << kMaxShards << ", default: single-threaded)\n"
+            << "  --journal rebuild the books from JOURNAL if it exists, "
+               "then append\n"
+            << "            every order and cancel to it\n"
+            << "  --fsync   when journal writes are synced: none, batch "
+               "(default), or\n"
+            << "            every MS milliseconds in the background\n"
+            << "  --load-snapshot  start from the books in SNAPSHOT, the "
+               "journal replays\n"
+            << "                   only what came after it\n"
+            << "  --save-snapshot  write the books to SNAPSHOT once the "
+               "input is done\n"
+            << "  --depth-feed     write the L2 level changes of every "
+               "action to FEED,\n"
+            << "                   in the --format of the results\n"
+            << "  Snapshots and the depth feed are single-threaded only.\n";
+}
+
+#ifdef SC_STATS
+static volatile std::sig_atomic_t stats_requested = 0;
+
+static void request_stats(int) { stats_requested = 1; }
+#endif
+
+/**
+ * With SC_STATS, kill -USR1 asks for a stats::dump to stderr, it is
+ * written at the next batch boundary, and once more at exit (force).
+*/
+static void poll_stats(bool force = false)
+{
+#ifdef SC_STATS
+  if (stats_requested || force) {
+    stats_requested = 0;
+    stats::dump(std::cerr);
+  }
+#else
+  (void)force;
+#endif
+}
+
+static bool parse_fsync(std::string_view arg, journal::Sync *sync,
+                        std::chrono::milliseconds *interval)
+{
+  if (arg == "none" || arg == "batch") {
+    *sync = (arg == "none") ? journal::Sync::kNone : journal::Sync::kBatch;
+    return true;
+  }
+  unsigned ms = 0;
+  auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), ms);
+  if (ec != std::errc() || end != arg.data() + arg.size()) {
+    return false;
+  }
+  *sync = journal::Sync::kInterval;
+  *interval = std::chrono::milliseconds(ms);
+  return true;
+}
+
+/**
+ * Reads all of the regular file at path into out.
+*/
+static bool read_file(const std::string &path, std::string *out,
+                      std::string *err)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    *err = path + ": " + std::strerror(errno);
+    return false;
+  }
+  struct stat st {
+  };
+  bool ok = (::fstat(fd, &st) == 0);
+  if (!ok) {
+    *err = path + ": " + std::strerror(errno);
+  } else if (!S_ISREG(st.st_mode)) {
+    *err = path + ": not a regular file";
+    ok = false;
+  }
+  if (ok) {
+    out->resize(static_cast<size_t>(st.st_size));
+  }
+  size_t done = 0;
+  while (ok && done < out->size()) {
+    ssize_t n = ::read(fd, out->data() + done, out->size() - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      *err = path + ": " + std::strerror(errno);
+      ok = false;
+    } else if (n == 0) {
+      *err = path + ": file shrank while being read";
+      ok = false;
+    } else {
+      done += static_cast<size_t>(n);
+    }
+  }
+  ::close(fd);
+  return ok;
+}
+
+/**
+ * Writes and syncs PATH.tmp, then renames it over path, so path is
+ * always either the old snapshot or the whole new one.
+*/
+static bool write_file(const std::string &path, std::string_view data,
+                       std::string *err)
+{
+  auto tmp = path + ".tmp";
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool ok = (fd >= 0);
+  while (ok && !data.empty()) {
+    ssize_t n = ::write(fd, data.data(), data.size());
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    ok = (n > 0);
+    if (ok) {
+      data.remove_prefix(static_cast<size_t>(n));
+    }
+  }
+  ok = ok && ::fsync(fd) == 0;
+  if (!ok) {
+    *err = tmp + ": " + std::strerror(errno);
+  }
+  if (fd >= 0) {
+    ::close(fd);
+  }
+  if (ok && std::rename(tmp.c_str(), path.c_str()) != 0) {
+    *err = path + ": " + std::strerror(errno);
+    ok = false;
+  }
+  return ok;
+}
+
+/**
+ * Rebuilds scross from the journal at path, if there is one, and has it
+ * journal everything from there on. An empty path means no journal.
+*/
+template <typename Engine>
+static bool attach_journal(const std::string &path, journal::Sync sync,
+                           std::chrono::milliseconds interval, Engine *scross,
+                           std::unique_ptr<journal::Journal> *journal,
+                           std::string *err)
+{
+  if (path.empty()) {
+    return true;
+  }
+  size_t records = 0;
+  if (!scross->recover(path, &records, err)) {
+    return false;
+  }
+  *journal = journal::Journal::open(path, sync, interval, err);
+  if (!*journal) {
+    return false;
+  }
+  scross->set_journal(journal->get());
+  return true;
+}
+
+/**
+ * Has out commit journal, if there is one, before it writes anything, so
+ * no result goes out ahead of the journaled actions it covers.
+*/
+static void commit_before_writes(journal::Journal *journal,
+                                 order::OutputBuffer *out)
+{
+  if (journal != nullptr) {
+    out->set_write_barrier([journal] { journal->commit(); });
+  }
+}
+
+static std::unique_ptr<order::ResultSink> make_sink(bool binary,
+                                                   order::OutputBuffer *out)
+{
+  if (binary) {
+    return std::make_unique<wire::BinarySink>(out);
+  }
+  return std::make_unique<order::BufferSink>(out);
+}
+
+static bool parse_shards(std::string_view arg, size_t *shards)
+{
+  auto [end, ec] =
+      std::from_chars(arg.data(), arg.data() + arg.size(), *shards);
+  return ec == std::errc() && end == arg.data() + arg.size() && *shards > 0 &&
+         *shards <= kMaxShards;
+}
 
 int main(int argc, char *argv[])
 {
-  (void)argc;
-  (void)argv;
-  SimpleCross scross;
-  std::string line;
-  WHILE_GETLINE(line)
-  {
-    results_t results = scross.action(line);
-    for (results_t::const_iterator it = results.begin(); it != results.end();
-         ++it) {
-      std::cout << *it << '\n';
+  ingest::Mode mode = ingest::Mode::kMmap;
+  bool binary = false;
+  size_t shards = 0;
+  std::string path = "-";
+  std::string journal_path;
+  std::string load_path;
+  std::string save_path;
+  std::string feed_path;
+  auto sync = journal::Sync::kBatch;
+  std::chrono::milliseconds sync_interval{0};
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg(argv[i]);
+    if (arg == "--mmap") {
+      mode = ingest::Mode::kMmap;
+    } else if (arg == "--read") {
+      mode = ingest::Mode::kRead;
+    } else if (arg == "--format" && i + 1 < argc &&
+               (std::string_view(argv[i + 1]) == "text" ||
+                std::string_view(argv[i + 1]) == "binary")) {
+      binary = (std::string_view(argv[++i]) == "binary");
+    } else if (arg == "--shards" && i + 1 < argc &&
+               parse_shards(argv[i + 1], &shards)) {
+      ++i;
+    } else if (arg == "--journal" && i + 1 < argc) {
+      journal_path = argv[++i];
+    } else if (arg == "--load-snapshot" && i + 1 < argc) {
+      load_path = argv[++i];
+    } else if (arg == "--save-snapshot" && i + 1 < argc) {
+      save_path = argv[++i];
+    } else if (arg == "--depth-feed" && i + 1 < argc) {
+      feed_path = argv[++i];
+    } else if (arg == "--fsync" && i + 1 < argc &&
+               parse_fsync(argv[i + 1], &sync, &sync_interval)) {
+      ++i;
+    } else if (arg.size() > 1 && arg.front() == '-') {
+      usage(argv[0]);
+      return (arg == "-h" || arg == "--help") ? 0 : 1;
+    } else {
+      path = arg;
+    }
+  }
+
+  if (shards > 0 &&
+      !(load_path.empty() && save_path.empty() && feed_path.empty())) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::string err;
+  auto source = ingest::open_source(path, mode, &err,
+                                    binary ? wire::kMessageSize : 0);
+  if (!source) {
+    std::cerr << err << '\n';
+    return 1;
+  }
+
+#ifdef SC_STATS
+  std::signal(SIGUSR1, request_stats);
+#endif
+  // Outlives either engine, and the outputs that commit it.
+  std::unique_ptr<journal::Journal> journal;
+  order::OutputBuffer out(STDOUT_FILENO);
+  ingest::line_batch_t batch;
+  try {
+    if (shards > 0) {
+      {
+        ShardedCross scross(shards,
+                            binary ? ShardedCross::Format::kBinary
+                                   : ShardedCross::Format::kText,
+                            &out);
+        if (!attach_journal(journal_path, sync, sync_interval, &scross,
+                            &journal, &err)) {
+          std::cerr << err << '\n';
+          return 1;
+        }
+        commit_before_writes(journal.get(), &out);
+        while (source->next_batch(&batch)) {
+          if (binary) {
+            scross.messages(batch);
+          } else {
+            scross.actions(batch);
+          }
+          if (batch.size() < ingest::kBatchLines) {
+            // The input is waiting on its writer, let everything matched
+            // so far out instead of holding it until the next batch.
+            scross.finish();
+          }
+          out.flush();
+          poll_stats();
+        }
+        scross.finish();
+        out.flush();
+      }
+      if (!source->error().empty()) {
+        std::cerr << path << ": " << source->error() << '\n';
+        return 1;
+      }
+      poll_stats(true);
+      return 0;
+    }
+
+    SimpleCross scross;
+    if (!load_path.empty()) {
+      std::string snapshot;
+      if (!read_file(load_path, &snapshot, &err)) {
+        std::cerr << err << '\n';
+        return 1;
+      }
+      if (!scross.load(snapshot, &err)) {
+        std::cerr << load_path << ": " << err << '\n';
+        return 1;
+      }
+    }
+    if (!attach_journal(journal_path, sync, sync_interval, &scross, &journal,
+                        &err)) {
+      std::cerr << err << '\n';
+      return 1;
+    }
+    commit_before_writes(journal.get(), &out);
+    std::unique_ptr<order::ResultSink> sink = make_sink(binary, &out);
+    std::unique_ptr<order::OutputBuffer> feed_out;
+    std::unique_ptr<order::ResultSink> feed;
+    int feed_fd = -1;
+    if (!feed_path.empty()) {
+      feed_fd = ::open(feed_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (feed_fd < 0) {
+        std::cerr << feed_path << ": " << std::strerror(errno) << '\n';
+        return 1;
+      }
+      feed_out = std::make_unique<order::OutputBuffer>(feed_fd);
+      commit_before_writes(journal.get(), feed_out.get());
+      feed = make_sink(binary, feed_out.get());
+      scross.set_depth_feed(feed.get());
+    }
+    while (source->next_batch(&batch)) {
+      if (binary) {
+        scross.messages(batch, sink.get());
+      } else {
+        scross.actions(batch, sink.get());
+      }
+      // Results go out per batch, so a slow pipe or a tty sees them as
+      // they're matched, not at 64 KiB or EOF.
+      out.flush();
+      if (feed_out) {
+        // A batch's deltas go out together, readers can follow the file.
+        feed_out->flush();
+      }
+      poll_stats();
+    }
+    if (feed_out) {
+      feed_out.reset();
+      ::close(feed_fd);
+    }
+    if (!source->error().empty()) {
+      // What was read is matched and out, but the books aren't all of it.
+      std::cerr << path << ": " << source->error() << '\n';
+      return 1;
+    }
+    if (!save_path.empty()) {
+      std::string snapshot;
+      scross.save(&snapshot);
+      if (!write_file(save_path, snapshot, &err)) {
+        std::cerr << err << '\n';
+        return 1;
+      }
     }
+  } catch (const std::system_error &e) {
+    // The journal or the output can't be written, stop before any more
+    // results go out.
+    std::cerr << e.what() << '\n';
+    return 1;
   }
+  poll_stats(true);
   return 0;
 }
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include "arena.h"
+
+namespace levelmap
+{
+
+constexpr size_t kFirstBlockSize = size_t{1} << 12;
+constexpr size_t kMaxBlockSize = size_t{1} << 20;
+
+Arena::~Arena()
+{
+  for (auto* block : blocks_) {
+    ::operator delete(block);
+  }
+}
+
+Arena::FreeList* Arena::free_list(size_t size)
+{
+  for (auto& list : free_lists_) {
+    if (list.size == size) {
+      return &list;
+    }
+  }
+  return nullptr;
+}
+
+void* Arena::new_block(size_t bytes)
+{
+  void* block = ::operator new(bytes);
+  blocks_.push_back(block);
+  reserved_ += bytes;
+  return block;
+}
+
+void* Arena::allocate(size_t bytes)
+{
+  auto size = round_up(bytes);
+  auto* list = free_list(size);
+  if (list == nullptr) {
+    // Set up now, deallocate can't allocate.
+    free_lists_.push_back(FreeList{size, nullptr});
+  } else if (list->head != nullptr) {
+    auto* block = list->head;
+    list->head = block->next;
+    return block;
+  }
+  if (size > kMaxBlockSize / 4) {
+    // Too big to share a block.
+    return new_block(size);
+  }
+  if (static_cast<size_t>(end_ - cursor_) < size) {
+    // Whatever is left of the current block is given up.
+    next_block_size_ = std::max(
+        std::clamp(2 * next_block_size_, kFirstBlockSize, kMaxBlockSize),
+        size);
+    cursor_ = static_cast<char*>(new_block(next_block_size_));
+    end_ = cursor_ + next_block_size_;
+  }
+  void* p = cursor_;
+  cursor_ += size;
+  return p;
+}
+
+void Arena::deallocate(void* p, size_t bytes) noexcept
+{
+  // allocate set up the list.
+  auto size = round_up(bytes);
+  for (auto& list : free_lists_) {
+    if (list.size == size) {
+      auto* block = static_cast<FreeBlock*>(p);
+      block->next = list.head;
+      list.head = block;
+      return;
+    }
+  }
+}
+
+}  // namespace levelmap
@@ -0,0 +1,113 @@
+#ifndef ORDER_BOOK_ARENA_H_
+#define ORDER_BOOK_ARENA_H_
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace levelmap
+{
+
+/**
+ * Per-book memory for levels, FIFO nodes, spill map nodes, and the tick
+ * window.
+ *
+ * Allocations are carved out of blocks that double in size up to
+ * kMaxBlockSize, and everything that is given back goes onto a free list
+ * for its (16 byte rounded) size instead of back to the heap, so a level
+ * that empties and comes back costs a free list pop, not a malloc/free
+ * pair. Nothing is returned to the heap before the Arena itself goes away.
+ * Alignment is at most alignof(std::max_align_t).
+*/
+class Arena
+{
+ public:
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  ~Arena();
+
+  void* allocate(size_t bytes);
+  void deallocate(void* p, size_t bytes) noexcept;
+
+  /**
+   * Bytes taken from the heap so far.
+  */
+  size_t reserved() const noexcept { return reserved_; }
+
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+  struct FreeList {
+    size_t size;
+    FreeBlock* head;
+  };
+
+  static size_t round_up(size_t bytes)
+  {
+    constexpr size_t kAlign = alignof(std::max_align_t);
+    return (bytes < kAlign) ? kAlign : (bytes + kAlign - 1) & ~(kAlign - 1);
+  }
+  FreeList* free_list(size_t size);
+  void* new_block(size_t bytes);
+
+  // Few distinct sizes are ever asked for, a short scan beats a map.
+  std::vector<FreeList> free_lists_;
+  std::vector<void*> blocks_;
+  char* cursor_ = nullptr;
+  char* end_ = nullptr;
+  size_t next_block_size_ = 0;
+  size_t reserved_ = 0;
+};
+
+/**
+ * std::allocator look-alike on top of an Arena, this is what LevelMap and
+ * its FIFOs are parameterized on. A default constructed ArenaAllocator has
+ * no Arena and goes straight to the heap, e.g. for a stand-alone LevelMap.
+*/
+template <typename T>
+class ArenaAllocator
+{
+ public:
+  using value_type = T;
+
+  ArenaAllocator() noexcept = default;
+  explicit ArenaAllocator(Arena* arena) noexcept : arena_(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+      : arena_(other.arena())
+  {
+  }
+
+  T* allocate(size_t n)
+  {
+    if (arena_ == nullptr) {
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    return static_cast<T*>(arena_->allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t n) noexcept
+  {
+    if (arena_ == nullptr) {
+      ::operator delete(p);
+    } else {
+      arena_->deallocate(p, n * sizeof(T));
+    }
+  }
+
+  Arena* arena() const noexcept { return arena_; }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& other) const noexcept
+  {
+    return arena_ == other.arena();
+  }
+
+ private:
+  Arena* arena_ = nullptr;
+};
+
+}  // namespace levelmap
+
+#endif  // ORDER_BOOK_ARENA_H_
@@ -1,104 +1,239 @@
 #ifndef ORDER_BOOK_LEVEL_MAP_H_
 #define ORDER_BOOK_LEVEL_MAP_H_
 #include <cstddef>
+#include <cstdint>
 #include <algorithm>
+#include <bit>
+#include <concepts>
+#include <deque>
+#include <functional>
 #include <map>
 #include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <stats.h>
+#include "arena.h"
 #include "order.h"
+#include "order_fifo.h"
 
 namespace levelmap
 {
+
+/**
+ * Number of consecutive price ticks addressable by direct indexing.
+ * Must be a multiple of 64 * 64 (one occupancy word covers 64 ticks, one
+ * summary word 64 occupancy words).
+ * At 5 decimals that is $1.31, about +-2.6 sigma of the per-symbol price
+ * spread gen_actions.py and the bench workload use, so nearly every level
+ * of a book is direct-indexed. Level pointers come in pages of 64 that
+ * are only allocated where levels are, see LevelMap::window_.
+*/
+constexpr size_t kWindowLevels = 1U << 17;
+
+/**
+ * Tombstones a std::deque level may hold before a cancel compacts it, see
+ * LevelMap::maybe_compact.
+*/
+constexpr size_t kCompactTombstones = 16;
+
 #ifdef __linux__ // TODO(andres): Use __has_feature instead, if possible.
-template <typename T>
-concept arithmetic = std::integral<T> || std::floating_point<T>;
-template <arithmetic Key, typename Value,
+template <std::integral Key, typename Value,
 #elif __APPLE__
 template <typename Key, typename Value,
 #endif  // OS
           template <typename, typename> class FifoContainer,
-          template <typename> class Compare>
+          template <typename> class Compare,
+          typename Alloc = std::allocator<Value>>
 class LevelMap
 {
  public:
+  using allocator_type = Alloc;
+  using fifo_t = FifoContainer<Value, Alloc>;
+  using pool_t = typename fifo_traits<fifo_t>::pool_type;
+  /**
+   * Intrusive FIFOs unlink cancelled orders, anything else (std::deque)
+   * keeps them around as 0-qty tombstones until update_book pops them.
+  */
+  static constexpr bool kIntrusive = fifo_traits<fifo_t>::kIntrusive;
+
   struct OQueue {
-    OQueue() = default;
-    size_t num_orders;
-    FifoContainer<Value, std::allocator<Value>> fifo;
+    explicit OQueue(pool_t* pool) : fifo(pool) {}
+    explicit OQueue(const Alloc& alloc) : fifo(alloc) {}
+    size_t num_orders = 0;
+    // Orders with qty left, std::deque tombstones aside
+    size_t live_orders = 0;
+    // Handle of the next order pushed, std::deque FIFOs only
+    order::fifo_idx_t next_idx = 0;
+    fifo_t fifo;
 
     void pop_front() { fifo.pop_front(); }
 
     decltype(auto) front() { return fifo.front(); }
 
-    template <typename Arg>
-    void push_back(Arg&& arg)
+    /**
+     * Returns a handle that stays valid for as long as the order is in the
+     * FIFO: the pool node for intrusive FIFOs, or for std::deque a count
+     * of the orders pushed before it, which the FIFO's copy keeps in idx.
+    */
+    order::fifo_idx_t push_back(const Value& v)
     {
-      return fifo.push_back(std::forward<Arg>(arg));
+      ++live_orders;
+      if constexpr (kIntrusive) {
+        return fifo.push_back(v);
+      } else {
+        fifo.push_back(v);
+        fifo.back().idx = next_idx;
+        return next_idx++;
+      }
     }
 
-    template <typename... Args>
-    void emplace_back(Args&&... args)
+    /**
+     * The order behind a handle from push_back, nullptr if it's gone.
+     * std::deque handles count up from the front, so an order is idx
+     * minus the front's handle in, or closer if compact() closed gaps in
+     * front of it, in which case it is binary searched for.
+    */
+    Value* find(order::fifo_idx_t idx)
     {
-      return fifo.emplace_back(std::forward<Args>(args)...);
+      if constexpr (kIntrusive) {
+        return fifo.find(idx);
+      } else {
+        if (fifo.empty()) {
+          return nullptr;
+        }
+        auto base = fifo.front().idx;
+        auto offset = static_cast<order::fifo_idx_t>(idx - base);
+        if (offset < fifo.size() && fifo[offset].idx == idx) {
+          return &fifo[offset];
+        }
+        auto last = fifo.begin() +
+                    static_cast<std::ptrdiff_t>(std::min<size_t>(
+                        size_t{offset} + 1, fifo.size()));
+        // Relative to the front, so handles that wrapped still sort.
+        auto it = std::lower_bound(
+            fifo.begin(), last, offset,
+            [base](const Value& o, order::fifo_idx_t off) {
+              return static_cast<order::fifo_idx_t>(o.idx - base) < off;
+            });
+        return (it != last && it->idx == idx) ? &*it : nullptr;
+      }
+    }
+
+    /**
+     * Cancelled orders still taking up room in a std::deque FIFO.
+    */
+    size_t tombstones() const { return fifo.size() - live_orders; }
+
+    /**
+     * Drops every tombstone, keeping the live orders in FIFO order and
+     * their handles valid. Returns how many went.
+    */
+    size_t compact()
+    {
+      auto before = fifo.size();
+      std::erase_if(fifo, [](const Value& o) { return o.qty == 0; });
+      return before - fifo.size();
     }
 
     size_t size() const { return fifo.size(); }
     bool empty() const { return num_orders == 0; }
   };
 
-  LevelMap() = default;
+  /**
+   * Levels, their FIFO storage, the tick window, and spill map nodes all
+   * come from alloc, e.g. an ArenaAllocator over a per-book Arena.
+  */
+  explicit LevelMap(const Alloc& alloc = Alloc())
+      : alloc_(alloc),
+        pool_(alloc),
+        window_(alloc),
+        occupied_(alloc),
+        summary_(alloc),
+        spill_(alloc),
+        spare_levels_(alloc)
+  {
+  }
+  // FIFOs point into pool_, so a LevelMap stays put.
+  LevelMap(const LevelMap&) = delete;
+  LevelMap& operator=(const LevelMap&) = delete;
+  ~LevelMap()
+  {
+    for (size_t w = 0; w < occupied_.size(); ++w) {
+      for (uint64_t bits = occupied_[w]; bits != 0; bits &= bits - 1) {
+        destroy_level(window_[w][std::countr_zero(bits)]);
+      }
+    }
+    PageAlloc page_alloc(alloc_);
+    for (auto* page : window_) {
+      if (page != nullptr) {
+        PageAllocTraits::deallocate(page_alloc, page, 64);
+      }
+    }
+    for (auto& [price, level] : spill_) {
+      destroy_level(level);
+    }
+    for (auto* level : spare_levels_) {
+      destroy_level(level);
+    }
+  }
 
   size_t fifos_size() const noexcept { return total_fifos_size_; }
 
-  bool level_empty(const Key& k) const { return fifo_map_.at(k).empty(); }
+  bool level_empty(const Key& k) const { return get_level(k).empty(); }
 
   size_t fifo_size_with_key(const Key& k)
   {
-    if (fifo_map_.count(k)) {
-      return fifo_map_.at(k).size();
-    }
-    return 0;
+    const OQueue* level = find_level(k);
+    return (level != nullptr) ? level->size() : 0;
   }
 
   decltype(auto) pop_front_with_key(const Key& k)
   {
     --total_fifos_size_;
-    return fifo_map_.at(k).pop_front();
+    return find_level_or_throw(k)->pop_front();
   }
 
   void dec_size() { --total_fifos_size_; }
 
   decltype(auto) front_with_key(const Key& k)
   {
-    return fifo_map_.at(k).front();
+    return find_level_or_throw(k)->front();
   }
 
-  decltype(auto) push_back_with_key(const Key& k, const Value& v)
+  order::fifo_idx_t push_back_with_key(const Key& k, const Value& v)
   {
-    OQueue* level = &fifo_map_[k];
+    OQueue* level = get_or_create_level(k);
     inc_counts(level, v.qty);
     ++total_fifos_size_;
     return level->push_back(v);
   }
 
-  size_t order_count() const noexcept { return num_orders_; }
-
-  decltype(auto) begin() { return fifo_map_.begin(); }
-
-  decltype(auto) end() { return fifo_map_.end(); }
-
-  decltype(auto) rbegin() { return fifo_map_.rbegin(); }
-
-  decltype(auto) rend() { return fifo_map_.rend(); }
-
-  decltype(auto) crbegin() const { return fifo_map_.crbegin(); }
+  /**
+   * Bulk load: appends n orders to the level at k, in order, looking the
+   * level up once. Their handles go to idxs.
+  */
+  void append_level(const Key& k, const Value* orders, size_t n,
+                    order::fifo_idx_t* idxs)
+  {
+    OQueue* level = get_or_create_level(k);
+    size_t qty = 0;
+    for (size_t i = 0; i < n; ++i) {
+      idxs[i] = level->push_back(orders[i]);
+      qty += orders[i].qty;
+    }
+    inc_counts(level, qty);
+    total_fifos_size_ += n;
+  }
 
-  decltype(auto) crend() const { return fifo_map_.crend(); }
+  size_t order_count() const noexcept { return num_orders_; }
 
   bool empty() const { return num_orders_ == 0; }
 
-  bool map_empty() const { return fifo_map_.empty(); }
+  bool map_empty() const { return map_size() == 0; }
 
-  bool map_size() const { return fifo_map_.size(); }
+  size_t map_size() const { return window_levels_ + spill_.size(); }
 
   bool fifos_empty() const { return fifos_size() == 0; }
 
@@ -120,11 +255,36 @@ class LevelMap
     num_orders_ -= count;
   }
 
-  void zero_out_order(order::price_t price, order::fifo_idx_t idx)
+  /**
+   * Takes a live order out of the book using the handle push_back_with_key
+   * returned for it. Intrusive FIFOs unlink the order in O(1), std::deque
+   * FIFOs 0 it out in place.
+   * If that leaves the level without any live quantity the level is
+   * dropped along with any tombstones right away, so the cached extremes
+   * never point at a dead level.
+   * Returns false if the handle no longer refers to order oid.
+  */
+  bool erase_order(const Key& price, order::fifo_idx_t idx, order::oid_t oid)
   {
-    OQueue* level = &fifo_map_[price];
-    dec_counts(level, level->fifo[idx].qty);
-    level->fifo[idx].qty = 0;
+    OQueue* level = find_level(price);
+    Value* v = (level != nullptr) ? level->find(idx) : nullptr;
+    if (v == nullptr || v->oid != oid || v->qty == 0) {
+      return false;
+    }
+    dec_counts(level, v->qty);
+    --level->live_orders;
+    if constexpr (kIntrusive) {
+      level->fifo.erase(idx);
+      --total_fifos_size_;
+    } else {
+      v->qty = 0;
+    }
+    if (level->empty()) {
+      erase(price);
+    } else if constexpr (!kIntrusive) {
+      maybe_compact(level);
+    }
+    return true;
   }
 
   /**
@@ -136,33 +296,534 @@ class LevelMap
    * Right now, this is only used in update_book with keys that were
    * found in the map.
   */
-  decltype(auto) erase(const Key& k)
+  void erase(const Key& k)
   {
     // We may be erasing a FIFO that reports 0-qty but has
     // Order objects inside, nevertheless.
-    total_fifos_size_ -= fifo_map_.at(k).size();
-    return fifo_map_.erase(k);
+    OQueue* level = find_level_or_throw(k);
+    total_fifos_size_ -= level->size();
+    if (in_window(k)) {
+      unmark(slot_of(k));
+    } else {
+      spill_.erase(k);
+    }
+    recycle_level(level);
+    STATS_COUNT(kLevelsErased, 1);
+    if (k == lowest_.first) {
+      lowest_ = lowest_level();
+    }
+    if (k == highest_.first) {
+      highest_ = highest_level();
+    }
+    auto best = best_level();
+    if (best.second != nullptr && !in_window(best.first)) {
+      // The touch moved past the window, e.g. in a sweep: follow it.
+      recenter(best.first);
+    }
+  }
+
+  /**
+   * The level at k, nullptr if there is none. Unlike get_level a missing
+   * level is expected, e.g. one that was just swept.
+  */
+  const OQueue* find(const Key& k) const { return find_level(k); }
+
+  /**
+   * True if the level at k is direct-indexed rather than spilled. The
+   * best level always is.
+  */
+  bool in_window(const Key& k) const
+  {
+    return !window_.empty() && k >= base_ &&
+           k - base_ < static_cast<Key>(kWindowLevels);
   }
 
-  const auto& get_level(const Key k) const { return fifo_map_.at(k); }
+  /**
+   * Cache hints for an order about to rest at or match against k, they
+   * change nothing. A level in the tick window is one slot away, a
+   * spilled one would take a tree walk to find and isn't worth it.
+  */
+  void prefetch(const Key& k) const
+  {
+    if (in_window(k)) {
+      if (const OQueue* level = window_slot(slot_of(k))) {
+        __builtin_prefetch(level);
+      }
+    }
+  }
+  void prefetch_best() const
+  {
+    if (const OQueue* level = best_level().second) {
+      __builtin_prefetch(level);
+    }
+  }
 
-  auto& get_first_level(const Value* order)
+  const OQueue& get_level(const Key k) const
+  {
+    const OQueue* level = find_level(k);
+    if (level == nullptr) {
+      throw std::out_of_range("No price level for key");
+    }
+    return *level;
+  }
+
+  /**
+   * Returns the {price, level} to match against next:
+   * the lowest price level for buys, the highest for sells.
+   * Only valid while !map_empty().
+  */
+  std::pair<Key, OQueue*> get_first_level(const Value* order)
   {
     if (order->side == order::OrderSide::kBuy) {
-      return *begin();
+      return lowest_;
+    } else {
+      return highest_;
+    }
+  }
+
+  /**
+   * The level an order from the other side matches against first, the
+   * front of Compare order: the lowest ask, or the highest bid for a map
+   * ordered by std::greater. Resolved at compile time, only valid while
+   * !map_empty().
+  */
+  std::pair<Key, OQueue*> best_level() const
+  {
+    if constexpr (kAscending) {
+      return lowest_;
     } else {
-      return *rbegin();
+      return highest_;
+    }
+  }
+
+  /**
+   * The extreme prices are cached and maintained as levels come and go,
+   * so these are O(1). Both return Key{} while map_empty().
+  */
+  Key lowest_price() const noexcept { return lowest_.first; }
+  Key highest_price() const noexcept { return highest_.first; }
+
+  /**
+   * Visits every (price, level) in Compare order, then in reverse.
+   * These replace iterating the underlying map, which is now split
+   * between the tick window and the spill map.
+   * f may return bool, false stops the walk there, e.g. after the best N
+   * levels.
+  */
+  template <typename F>
+  void for_each_level(F&& f) const
+  {
+    auto it = spill_.cbegin();
+    for (; it != spill_.cend() && precedes_window(it->first); ++it) {
+      if (!visit(f, it->first, *it->second)) {
+        return;
+      }
+    }
+    if (!for_each_window_level(f, kAscending)) {
+      return;
+    }
+    for (; it != spill_.cend(); ++it) {
+      if (!visit(f, it->first, *it->second)) {
+        return;
+      }
+    }
+  }
+
+  template <typename F>
+  void rfor_each_level(F&& f) const
+  {
+    auto it = spill_.crbegin();
+    for (; it != spill_.crend() && !precedes_window(it->first); ++it) {
+      if (!visit(f, it->first, *it->second)) {
+        return;
+      }
+    }
+    if (!for_each_window_level(f, !kAscending)) {
+      return;
+    }
+    for (; it != spill_.crend(); ++it) {
+      if (!visit(f, it->first, *it->second)) {
+        return;
+      }
     }
   }
 
  private:
-  std::map<Key, OQueue, Compare<Key>> fifo_map_;
-  size_t num_orders_;
-  size_t total_fifos_size_;
+  static constexpr size_t kWords = kWindowLevels / 64;
+  static constexpr size_t kSummaryWords = kWords / 64;
+  static constexpr bool kAscending = Compare<Key>{}(Key{0}, Key{1});
+  static_assert(kWindowLevels % (64 * 64) == 0);
+
+  size_t slot_of(const Key& k) const { return static_cast<size_t>(k - base_); }
+
+  /**
+   * True if a spill key sorts ahead of the entire window in Compare order.
+   * Spill keys never fall inside the window.
+  */
+  bool precedes_window(const Key& k) const
+  {
+    return window_.empty() || Compare<Key>{}(k, base_);
+  }
+
+  OQueue* find_level(const Key& k) const
+  {
+    if (in_window(k)) {
+      return window_slot(slot_of(k));
+    }
+    auto it = spill_.find(k);
+    return (it != spill_.end()) ? it->second : nullptr;
+  }
+
+  OQueue* find_level_or_throw(const Key& k) const
+  {
+    OQueue* level = find_level(k);
+    if (level == nullptr) {
+      throw std::out_of_range("No price level for key");
+    }
+    return level;
+  }
+
+  OQueue* get_or_create_level(const Key& k)
+  {
+    if (!in_window(k) &&
+        (map_empty() || Compare<Key>{}(k, best_level().first))) {
+      // A new best level outside of the window, follow it.
+      recenter(k);
+    }
+    if (in_window(k)) {
+      auto slot = slot_of(k);
+      if (OQueue* level = window_slot(slot)) {
+        return level;
+      }
+      OQueue* level = make_level();
+      mark(slot, level);
+      track_new_level(k, level);
+      return level;
+    }
+    auto& level = spill_[k];
+    if (!level) {
+      level = make_level();
+      track_new_level(k, level);
+    }
+    return level;
+  }
+
+  /**
+   * Levels that empty out are kept for the next new level instead of
+   * being freed, FIFO storage included (a cleared std::deque holds on to
+   * a block).
+  */
+  OQueue* make_level()
+  {
+    if (!spare_levels_.empty()) {
+      OQueue* level = spare_levels_.back();
+      spare_levels_.pop_back();
+      return level;
+    }
+    LevelAlloc alloc(alloc_);
+    OQueue* level = LevelAllocTraits::allocate(alloc, 1);
+    if constexpr (kIntrusive) {
+      LevelAllocTraits::construct(alloc, level, &pool_);
+    } else {
+      LevelAllocTraits::construct(alloc, level, alloc_);
+    }
+    return level;
+  }
+
+  /**
+   * std::deque FIFOs: compacts a level once its tombstones outnumber both
+   * kCompactTombstones and its live orders. Each compaction of n entries
+   * drops more than n / 2 tombstones, each left by one cancel, so this is
+   * amortized O(1) per cancel, and matching never skips more than that
+   * many tombstones on a level however many cancels came before it.
+  */
+  void maybe_compact(OQueue* level)
+  {
+    auto dead = level->tombstones();
+    if (dead > kCompactTombstones && dead > level->live_orders) {
+      total_fifos_size_ -= level->compact();
+      STATS_COUNT(kTombstonesCompacted, dead);
+    }
+  }
+
+  void recycle_level(OQueue* level)
+  {
+    // Drops any std::deque tombstones.
+    level->fifo.clear();
+    level->num_orders = 0;
+    level->live_orders = 0;
+    level->next_idx = 0;
+    spare_levels_.push_back(level);
+  }
+
+  void destroy_level(OQueue* level)
+  {
+    LevelAlloc alloc(alloc_);
+    LevelAllocTraits::destroy(alloc, level);
+    LevelAllocTraits::deallocate(alloc, level, 1);
+  }
+
+  void track_new_level(const Key& k, OQueue* level)
+  {
+    STATS_COUNT(kLevelsCreated, 1);
+    if (lowest_.second == nullptr || k < lowest_.first) {
+      lowest_ = {k, level};
+    }
+    if (highest_.second == nullptr || k > highest_.first) {
+      highest_ = {k, level};
+    }
+  }
+
+  /**
+   * Moves the window so that k sits in its middle.
+   * Levels that fall out of the window are spilled to the sparse map and
+   * spilled levels that now fall inside the window are adopted by it.
+   * The window is kept on the best level: matching, and most new levels,
+   * happen around it. Recentering costs the levels it moves, and the best
+   * level has to move half a window from where the window was last
+   * centered before it happens again.
+  */
+  void recenter(const Key& k)
+  {
+    if (window_.empty()) {
+      window_.resize(kWords, nullptr);
+      occupied_.resize(kWords);
+      summary_.resize(kSummaryWords);
+    }
+    for (size_t s = 0; s < kSummaryWords; ++s) {
+      for (uint64_t words = summary_[s]; words != 0; words &= words - 1) {
+        size_t w = s * 64 + static_cast<size_t>(std::countr_zero(words));
+        for (uint64_t bits = occupied_[w]; bits != 0; bits &= bits - 1) {
+          auto bit = static_cast<size_t>(std::countr_zero(bits));
+          spill_.emplace(base_ + static_cast<Key>(w * 64 + bit),
+                         window_[w][bit]);
+          window_[w][bit] = nullptr;
+        }
+        occupied_[w] = 0;
+      }
+      summary_[s] = 0;
+    }
+    window_levels_ = 0;
+    base_ = k - static_cast<Key>(kWindowLevels / 2);
+
+    auto first = kAscending
+                     ? base_
+                     : base_ + static_cast<Key>(kWindowLevels) - 1;
+    auto it = spill_.lower_bound(first);
+    while (it != spill_.end() && in_window(it->first)) {
+      mark(slot_of(it->first), it->second);
+      it = spill_.erase(it);
+    }
+  }
+
+  /**
+   * The level in a window slot, nullptr if there's none.
+  */
+  OQueue* window_slot(size_t slot) const
+  {
+    const auto* page = window_[slot / 64];
+    return (page != nullptr) ? page[slot % 64] : nullptr;
+  }
+
+  /**
+   * Puts level in an empty slot, allocating the slot's page if need be.
+  */
+  void mark(size_t slot, OQueue* level)
+  {
+    auto w = slot / 64;
+    if (window_[w] == nullptr) {
+      PageAlloc page_alloc(alloc_);
+      window_[w] = PageAllocTraits::allocate(page_alloc, 64);
+      std::fill_n(window_[w], 64, nullptr);
+    }
+    window_[w][slot % 64] = level;
+    occupied_[w] |= uint64_t{1} << (slot % 64);
+    summary_[w / 64] |= uint64_t{1} << (w % 64);
+    ++window_levels_;
+  }
+
+  /**
+   * Empties a slot. Its page stays, levels tend to come back to the same
+   * prices.
+  */
+  void unmark(size_t slot)
+  {
+    auto w = slot / 64;
+    window_[w][slot % 64] = nullptr;
+    occupied_[w] &= ~(uint64_t{1} << (slot % 64));
+    if (occupied_[w] == 0) {
+      summary_[w / 64] &= ~(uint64_t{1} << (w % 64));
+    }
+    --window_levels_;
+  }
+
+  std::pair<Key, OQueue*> window_level(size_t slot) const
+  {
+    return {base_ + static_cast<Key>(slot), window_[slot / 64][slot % 64]};
+  }
+
+  /**
+   * The first and last occupied words of the window, through the summary.
+   * Only valid while window_levels_ != 0.
+  */
+  size_t first_word() const
+  {
+    size_t s = 0;
+    while (summary_[s] == 0) {
+      ++s;
+    }
+    return s * 64 + static_cast<size_t>(std::countr_zero(summary_[s]));
+  }
+  size_t last_word() const
+  {
+    size_t s = kSummaryWords - 1;
+    while (summary_[s] == 0) {
+      --s;
+    }
+    return s * 64 + 63 - static_cast<size_t>(std::countl_zero(summary_[s]));
+  }
+
+  /**
+   * Full scans backing the cached extremes, {Key{}, nullptr} if empty.
+  */
+  std::pair<Key, OQueue*> lowest_level() const
+  {
+    const auto* spilled = spill_.empty()        ? nullptr
+                          : kAscending ? &*spill_.cbegin()
+                                       : &*spill_.crbegin();
+    if (window_levels_ != 0) {
+      auto w = first_word();
+      auto level = window_level(
+          w * 64 + static_cast<size_t>(std::countr_zero(occupied_[w])));
+      if (spilled == nullptr || level.first < spilled->first) {
+        return level;
+      }
+    }
+    if (spilled == nullptr) {
+      return {Key{}, nullptr};
+    }
+    return {spilled->first, spilled->second};
+  }
+
+  std::pair<Key, OQueue*> highest_level() const
+  {
+    const auto* spilled = spill_.empty()        ? nullptr
+                          : kAscending ? &*spill_.crbegin()
+                                       : &*spill_.cbegin();
+    if (window_levels_ != 0) {
+      auto w = last_word();
+      auto level = window_level(
+          w * 64 + 63 - static_cast<size_t>(std::countl_zero(occupied_[w])));
+      if (spilled == nullptr || level.first > spilled->first) {
+        return level;
+      }
+    }
+    if (spilled == nullptr) {
+      return {Key{}, nullptr};
+    }
+    return {spilled->first, spilled->second};
+  }
+
+  /**
+   * Calls f, a void f always goes on.
+  */
+  template <typename F>
+  static bool visit(F& f, const Key& k, const OQueue& level)
+  {
+    if constexpr (std::is_void_v<std::invoke_result_t<F&, const Key&,
+                                                      const OQueue&>>) {
+      f(k, level);
+      return true;
+    } else {
+      return f(k, level);
+    }
+  }
+
+  /**
+   * Returns false if f stopped the walk.
+  */
+  template <typename F>
+  bool for_each_window_level(F& f, bool ascending) const
+  {
+    if (window_levels_ == 0) {
+      return true;
+    }
+    if (ascending) {
+      for (auto w = first_word(), last = last_word(); w <= last; ++w) {
+        for (uint64_t bits = occupied_[w]; bits != 0; bits &= bits - 1) {
+          auto [price, level] = window_level(
+              w * 64 + static_cast<size_t>(std::countr_zero(bits)));
+          if (!visit(f, price, *level)) {
+            return false;
+          }
+        }
+      }
+    } else {
+      for (auto w = last_word() + 1, first = first_word(); w-- > first;) {
+        for (uint64_t bits = occupied_[w]; bits != 0;) {
+          auto top = 63 - static_cast<size_t>(std::countl_zero(bits));
+          bits &= ~(uint64_t{1} << top);
+          auto [price, level] = window_level(w * 64 + top);
+          if (!visit(f, price, *level)) {
+            return false;
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  template <typename T>
+  using rebind_t =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+  using LevelAlloc = rebind_t<OQueue>;
+  using LevelAllocTraits = std::allocator_traits<LevelAlloc>;
+  using PageAlloc = rebind_t<OQueue*>;
+  using PageAllocTraits = std::allocator_traits<PageAlloc>;
+
+  Alloc alloc_;
+  // Shared node storage for intrusive FIFOs, outlives every level
+  [[no_unique_address]] pool_t pool_;
+  // Direct-mapped levels for [base_, base_ + kWindowLevels), in pages of
+  // 64 slots, one per occupancy word, allocated when a level first lands
+  std::vector<OQueue**, rebind_t<OQueue**>> window_;
+  // One bit per window slot, set when the slot holds a level
+  std::vector<uint64_t, rebind_t<uint64_t>> occupied_;
+  // One bit per occupancy word, set when the word isn't 0
+  std::vector<uint64_t, rebind_t<uint64_t>> summary_;
+  Key base_{};
+  size_t window_levels_ = 0;
+  // Outliers that fall outside of the window
+  std::map<Key, OQueue*, Compare<Key>,
+           rebind_t<std::pair<const Key, OQueue*>>>
+      spill_;
+  // Emptied levels waiting to be reused
+  std::vector<OQueue*, rebind_t<OQueue*>> spare_levels_;
+  // Cached extremes, the level pointers survive recentering
+  std::pair<Key, OQueue*> lowest_{Key{}, nullptr};
+  std::pair<Key, OQueue*> highest_{Key{}, nullptr};
+  size_t num_orders_ = 0;
+  size_t total_fifos_size_ = 0;
 };
 
-using MinLevelMap =
-    LevelMap<order::price_t, order::Order, std::deque, std::less>;
+#if defined(DEQUE_FIFO)
+template <template <typename> class Compare>
+using OrderLevelMap = LevelMap<order::price_t, order::Order, std::deque,
+                               Compare, ArenaAllocator<order::Order>>;
+#else   // DEQUE_FIFO
+template <template <typename> class Compare>
+using OrderLevelMap = LevelMap<order::price_t, order::Order, IntrusiveFifo,
+                               Compare, ArenaAllocator<order::Order>>;
+#endif  // DEQUE_FIFO
+
+/**
+ * Asks, best (lowest) price first.
+*/
+using MinLevelMap = OrderLevelMap<std::less>;
+/**
+ * Bids, best (highest) price first.
+*/
+using MaxLevelMap = OrderLevelMap<std::greater>;
 
 }  // namespace levelmap
 
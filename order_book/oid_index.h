@@ -0,0 +1,142 @@
+#ifndef ORDER_BOOK_OID_INDEX_H_
+#define ORDER_BOOK_OID_INDEX_H_
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <memory>
+#include <vector>
+#include "order.h"
+
+namespace order
+{
+
+/**
+ * Direct-mapped OID -> Ref look-up.
+ *
+ * OIDs come from the gateway as dense 32-bit integers, so instead of hashing
+ * them we split the OID space into fixed-size pages of Refs that are indexed
+ * directly. Pages are allocated the first time an OID lands in them and
+ * given back once their last OID is erased (one spare page is kept around so
+ * a page boundary doesn't churn the allocator). Inserting and erasing never
+ * allocate per order.
+*/
+template <typename Ref>
+class OidIndex
+{
+ public:
+  OidIndex() = default;
+
+  bool contains(oid_t oid) const { return find(oid) != nullptr; }
+
+  const Ref* find(oid_t oid) const
+  {
+    const Page* page = page_of(oid);
+    if (page == nullptr || !page->test(slot_of(oid))) {
+      return nullptr;
+    }
+    return &page->refs[slot_of(oid)];
+  }
+
+  Ref* find(oid_t oid)
+  {
+    return const_cast<Ref*>(static_cast<const OidIndex*>(this)->find(oid));
+  }
+
+  /**
+   * Only a hint: starts pulling oid's slot and its occupied bit into the
+   * cache ahead of a find, insert, or erase. Nothing if oid's page isn't
+   * there.
+  */
+  void prefetch(oid_t oid) const
+  {
+    if (const Page* page = page_of(oid)) {
+      auto slot = slot_of(oid);
+      __builtin_prefetch(&page->refs[slot]);
+      __builtin_prefetch(&page->occupied[slot / 64]);
+    }
+  }
+
+  /**
+   * Inserts or overwrites the Ref for oid.
+  */
+  Ref& insert(oid_t oid, const Ref& ref)
+  {
+    size_t page_idx = oid >> kPageShift;
+    if (page_idx >= pages_.size()) {
+      pages_.resize(page_idx + 1);
+    }
+    auto& page = pages_[page_idx];
+    if (!page) {
+      page = spare_ ? std::move(spare_) : std::make_unique<Page>();
+    }
+    auto slot = slot_of(oid);
+    if (!page->test(slot)) {
+      page->set(slot);
+      ++page->live;
+      ++size_;
+    }
+    return page->refs[slot] = ref;
+  }
+
+  /**
+   * Returns false if oid wasn't in the index.
+  */
+  bool erase(oid_t oid)
+  {
+    size_t page_idx = oid >> kPageShift;
+    if (page_idx >= pages_.size() || !pages_[page_idx]) {
+      return false;
+    }
+    auto& page = pages_[page_idx];
+    auto slot = slot_of(oid);
+    if (!page->test(slot)) {
+      return false;
+    }
+    page->reset(slot);
+    --size_;
+    if (--page->live == 0) {
+      spare_ = std::move(page);
+    }
+    return true;
+  }
+
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+ private:
+  static constexpr size_t kPageShift = 12;
+  static constexpr size_t kPageSize = size_t{1} << kPageShift;
+  static constexpr size_t kPageMask = kPageSize - 1;
+
+  struct Page {
+    std::array<Ref, kPageSize> refs;
+    std::array<uint64_t, kPageSize / 64> occupied{};
+    size_t live = 0;
+
+    bool test(size_t slot) const
+    {
+      return (occupied[slot / 64] >> (slot % 64)) & 1U;
+    }
+    void set(size_t slot) { occupied[slot / 64] |= uint64_t{1} << (slot % 64); }
+    void reset(size_t slot)
+    {
+      occupied[slot / 64] &= ~(uint64_t{1} << (slot % 64));
+    }
+  };
+
+  static size_t slot_of(oid_t oid) { return oid & kPageMask; }
+
+  const Page* page_of(oid_t oid) const
+  {
+    size_t page_idx = oid >> kPageShift;
+    return (page_idx < pages_.size()) ? pages_[page_idx].get() : nullptr;
+  }
+
+  std::vector<std::unique_ptr<Page>> pages_;
+  std::unique_ptr<Page> spare_;
+  size_t size_ = 0;
+};
+
+}  // namespace order
+
+#endif  // ORDER_BOOK_OID_INDEX_H_
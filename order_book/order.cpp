@@ -1,125 +1,127 @@
-#include <sstream>
-#include <iomanip>
-#include <list>
-#include <numeric>
+#include <limits>
+#include <string>
+#include <string_view>
 #include "order.h"
+#include "result_sink.h"
+#include "symbol_table.h"
 
 namespace order
 {
-constexpr uint8_t kPrintPrecision = 5U;
 constexpr qty_t kMaxQuantity = std::numeric_limits<order::qty_t>::max();
 constexpr oid_t kMaxOID = std::numeric_limits<oid_t>::max();
 constexpr fifo_idx_t kMaxDQIdx = std::numeric_limits<fifo_idx_t>::max();
 constexpr size_t kMaxSymbolSize = 8;
-constexpr order::price_t kMaxPrice = 9999999.99999;
+constexpr order::price_t kMaxPrice = 999999999999;  // 9999999.99999
+constexpr order::price_t kPriceScale = 100000;
+constexpr uint8_t kPriceDecimals = 5U;
+constexpr symbol_id_t kInvalidSymbol =
+    std::numeric_limits<symbol_id_t>::max();
+constexpr size_t kReservedFills = size_t{1} << 12;
 
-Order::Order()
-    : oid(kMaxOID), side(OrderSide::kBuy), qty(0), price(0.0), idx(kMaxDQIdx)
+/**
+ * Same formatting as BufferSink, through a scratch OutputBuffer instead
+ * of a std::stringstream.
+*/
+std::string Order::str(std::string_view symbol_name, char prepend,
+                       bool print_side) const
 {
-}
-Order::Order(oid_t oid, symbol_t symbol, OrderSide side, qty_t qty,
-             price_t price)
-    : oid(oid),
-      symbol(symbol),
-      side(side),
-      qty(qty),
-      price(price),
-      idx(kMaxDQIdx)
-{
-}
-Order::Order(const Order& other)
-    : oid(other.oid),
-      symbol(other.symbol),
-      side(other.side),
-      qty(other.qty),
-      price(other.price),
-      idx(other.idx)
-{
-}
-Order::Order(Order&& other)
-    : oid(other.oid),
-      symbol(other.symbol),
-      side(other.side),
-      qty(other.qty),
-      price(other.price),
-      idx(other.idx)
-{
-  if (this == &other) {
-    return;
+  OutputBuffer out;
+  if (prepend != '\0') {
+    out.push_back(prepend);
+    out.push_back(' ');
   }
-  other.oid = kMaxOID;
-  other.symbol = "";
-  other.side = OrderSide::kBuy;
-  other.qty = 0;
-  other.price = 0.0;
-  other.idx = kMaxDQIdx;
-}
-
-Order& Order::operator=(const Order& other)
-{
-  if (this == &other) {
-    return *this;
+  out.put_uint(oid);
+  out.push_back(' ');
+  out.append(symbol_name);
+  out.push_back(' ');
+  if (print_side) {
+    out.push_back(static_cast<char>(side));
+    out.push_back(' ');
   }
-  symbol = other.symbol;
-  oid = other.oid;
-  side = other.side;
-  qty = other.qty;
-  price = other.price;
-  idx = other.idx;
-  return *this;
+  out.put_uint(qty);
+  out.push_back(' ');
+  out.put_price(price);
+  return std::string(out.view());
 }
 
-Order& Order::operator=(Order&& other)
+std::string error_message(ErrorCode code, oid_t oid)
 {
-  if (this == &other) {
-    return *this;
+  switch (code) {
+    case ErrorCode::kDuplicateOid:
+      return std::to_string(oid) + " Duplicate order id";
+    case ErrorCode::kInvalidPrice:
+      return std::to_string(oid) + " Invalid price, <= 0";
+    case ErrorCode::kInvalidOid:
+      return "Invalid OID: " + std::to_string(oid);
+    case ErrorCode::kInvalidAction:
+      return std::to_string(oid) + " Invalid action";
+    case ErrorCode::kInvalidSymbol:
+      return std::to_string(oid) + " Invalid Symbol";
+    case ErrorCode::kInvalidSide:
+      return std::to_string(oid) + " Invalid order side";
+    case ErrorCode::kInvalidQuantity:
+      return std::to_string(oid) + " Quantity out of valid range";
+    case ErrorCode::kPriceOutOfRange:
+      return std::to_string(oid) + " Price <= 0 || > 9999999.99999 ";
+    case ErrorCode::kNone:
+      break;
   }
-  symbol = other.symbol;
-  oid = other.oid;
-  side = other.side;
-  qty = other.qty;
-  price = other.price;
-  idx = other.idx;
-
-  other.oid = kMaxOID;
-  other.symbol = "";
-  other.side = OrderSide::kBuy;
-  other.qty = 0;
-  other.price = 0.0;
-  other.idx = kMaxDQIdx;
-  return *this;
+  return std::to_string(oid);
 }
 
-std::string Order::str(char prepend, bool print_side) const
+void OrderResult::clear()
 {
-  std::stringstream order_stream;
-  if (prepend != '\0') {
-    order_stream << prepend << ' ';
-  }
-  order_stream << oid << ' ' << symbol << ' ';
-  if (print_side) {
-    char side_char = (side == OrderSide::kBuy) ? 'B' : 'S';
-    order_stream << side_char << ' ';
-  }
-  order_stream << qty << ' ';
-  std::stringstream price_stream;
-  price_stream << std::fixed << std::setprecision(kPrintPrecision) << price;
-  return order_stream.str() + price_stream.str();
+  type = ResultType::kNop;
+  error = ErrorCode::kNone;
+  order = Order{};
+  fills.clear();
 }
 
-std::list<std::string> OrderResult::serialize() const
+/**
+ * Shared by OrderResult and BatchResult, fills are only looked at for a
+ * kFilled.
+*/
+static void serialize_result(ResultType type, ErrorCode error, oid_t oid,
+                             const Execution *fills, size_t num_fills,
+                             const SymbolTable &symbols, ResultSink *sink)
 {
-  std::list<std::string> result;
   if (type == ResultType::kFilled) {
-    for (const auto& o : orders) {
-      result.push_back(o.str('F', false));
+    for (size_t i = 0; i < num_fills; ++i) {
+      const auto &e = fills[i];
+      const auto &symbol = symbols.name(e.symbol);
+      auto resting_side =
+          (e.side == OrderSide::kBuy) ? OrderSide::kSell : OrderSide::kBuy;
+      sink->fill(Order(e.aggressor, e.symbol, e.side, e.qty, e.price), symbol);
+      sink->fill(Order(e.resting, e.symbol, resting_side, e.qty, e.price),
+                 symbol);
     }
   } else if (type == ResultType::kError) {
-    result.push_back("E " + error_msg);
+    sink->error(error, oid);
   } else if (type == ResultType::kCancelled) {
-    result.push_back("X " + std::to_string(orders.front().oid));
+    sink->cancel(oid);
   }
-  return result;
+}
+
+void OrderResult::serialize(const SymbolTable &symbols,
+                            ResultSink *sink) const
+{
+  serialize_result(type, error, order.oid, fills.data(), fills.size(),
+                   symbols, sink);
+}
+
+void BatchResult::clear()
+{
+  entries.clear();
+  fills.clear();
+}
+
+void BatchResult::serialize(size_t i, const SymbolTable &symbols,
+                            ResultSink *sink) const
+{
+  const auto &entry = entries[i];
+  serialize_result(entry.type, entry.error, entry.order.oid,
+                   fills.data() + entry.first_fill, entry.num_fills, symbols,
+                   sink);
 }
 
 }  // namespace order
@@ -1,47 +1,80 @@
 #ifndef ORDER_BOOK_ORDER_H_
 #define ORDER_BOOK_ORDER_H_
 #include <string>
+#include <string_view>
 #include <list>
 #include <vector>
 #include <queue>
 #include <numeric>
 #include <cstdint>
+#include <type_traits>
 
 namespace order
 {
 
-enum class OrderSide {
+enum class OrderSide : char {
   kSell = 'S',
   kBuy = 'B',
 };
 
 using oid_t = uint32_t;
 using qty_t = uint16_t;
-using price_t = double;
+using price_t = int64_t;  // fixed-point ticks, see kPriceScale
 using fifo_idx_t = uint32_t;
 using symbol_t = std::string;
+using symbol_id_t = uint32_t;  // see SymbolTable
 
 const extern qty_t kMaxQuantity;
 const extern oid_t kMaxOID;
 const extern fifo_idx_t kMaxDQIdx;
 const extern size_t kMaxSymbolSize;
 const extern order::price_t kMaxPrice;
+const extern order::price_t kPriceScale;
+const extern uint8_t kPriceDecimals;
+const extern symbol_id_t kInvalidSymbol;
+const extern size_t kReservedFills;
 
+class SymbolTable;
+class ResultSink;
+
+/**
+ * The record the books match on. It is trivially copyable and 24 bytes,
+ * widest field first: copying one into a FIFO or a result is a memcpy, and
+ * an IntrusiveFifo node (an Order plus two 32-bit links) is 32 bytes, two
+ * to a cache line. Anything cold stays out of it, the symbol's name lives
+ * in the SymbolTable and is only looked up to print.
+*/
 struct Order {
-  oid_t oid;
-  symbol_t symbol;
-  OrderSide side;
-  qty_t qty;
-  price_t price;
-  fifo_idx_t idx;
-  Order();
-  Order(oid_t oid, symbol_t symbol, OrderSide side, qty_t qty, price_t price);
-  ~Order() = default;
-  Order(const Order& other);
-  Order(Order&& other);
-  Order& operator=(const Order& other);
-  Order& operator=(Order&& other);
-  std::string str(char prepend, bool print_side = true) const;
+  price_t price = 0;
+  oid_t oid = kMaxOID;
+  symbol_id_t symbol = kInvalidSymbol;
+  // FIFO handle while resting, see OrderBook::place_order
+  fifo_idx_t idx = kMaxDQIdx;
+  qty_t qty = 0;
+  OrderSide side = OrderSide::kBuy;
+
+  Order() = default;
+  Order(oid_t oid, symbol_id_t symbol, OrderSide side, qty_t qty,
+        price_t price)
+      : price(price), oid(oid), symbol(symbol), qty(qty), side(side)
+  {
+  }
+  std::string str(std::string_view symbol_name, char prepend,
+                  bool print_side = true) const;
+};
+
+static_assert(std::is_trivially_copyable_v<Order>);
+static_assert(sizeof(Order) <= 24);
+
+/**
+ * L2 aggregate of one price level: the qty left at price and how many
+ * orders it is split across. Both are 0 once the level is gone.
+*/
+struct LevelDepth {
+  price_t price = 0;
+  uint64_t qty = 0;
+  uint32_t orders = 0;
+  OrderSide side = OrderSide::kBuy;
 };
 
 enum class ResultType {
@@ -51,11 +84,97 @@ enum class ResultType {
   kCancelled,
 };
 
+/**
+ * Why an action was rejected. The first few come from BookMap, the rest
+ * from decoding binary messages (see wire.h), the text parser reports
+ * its own errors as plain lines.
+*/
+enum class ErrorCode : uint8_t {
+  kNone,
+  kDuplicateOid,
+  kInvalidPrice,
+  kInvalidOid,
+  kInvalidAction,
+  kInvalidSymbol,
+  kInvalidSide,
+  kInvalidQuantity,
+  kPriceOutOfRange,
+};
+
+/**
+ * What gets printed after "E " for an error.
+*/
+std::string error_message(ErrorCode code, oid_t oid);
+
+/**
+ * One fill as the matcher records it: the incoming (aggressor) order
+ * traded qty with a resting order at price. It prints as two F lines, the
+ * aggressor's then the resting order's. 24 bytes, half of the two Orders
+ * a fill used to take.
+*/
+struct Execution {
+  price_t price;
+  oid_t aggressor;
+  oid_t resting;
+  symbol_id_t symbol;
+  qty_t qty;
+  // The aggressor's, the resting order is on the other side
+  OrderSide side;
+};
+
+static_assert(std::is_trivially_copyable_v<Execution>);
+static_assert(sizeof(Execution) <= 24);
+
 struct OrderResult {
   ResultType type;
-  std::string error_msg;
-  std::deque<Order> orders;
-  std::list<std::string> serialize() const;
+  ErrorCode error;
+  // For kCancelled and kError, the order the result is about
+  Order order;
+  // For kFilled, in the order they happened. The engines reserve
+  // kReservedFills up front and clear() keeps the capacity, so matching
+  // doesn't allocate unless one order sweeps more than that.
+  std::vector<Execution> fills;
+  /**
+   * Empties the result so it can be reused for the next action.
+  */
+  void clear();
+  void serialize(const SymbolTable& symbols, ResultSink* sink) const;
+};
+
+/**
+ * One decoded order or cancel for BookMap::handle_batch, a cancel only
+ * looks at order.oid.
+*/
+struct BookRequest {
+  Order order;
+  bool cancel = false;
+};
+
+/**
+ * What BookMap::handle_batch writes: entries[i] is the result of request
+ * i, and the fills of every entry share one buffer, entry i's being
+ * fills[first_fill, first_fill + num_fills). clear() keeps the capacity
+ * of both, so a BatchResult reused across bursts stops allocating.
+*/
+struct BatchResult {
+  struct Entry {
+    ResultType type;
+    ErrorCode error;
+    // A placed order as the book left it (remaining qty and FIFO handle),
+    // otherwise the order a kCancelled or kError is about
+    Order order;
+    uint32_t first_fill;
+    uint32_t num_fills;
+  };
+  std::vector<Entry> entries;
+  std::vector<Execution> fills;
+
+  void clear();
+  /**
+   * Writes entry i the way OrderResult::serialize writes a result.
+  */
+  void serialize(size_t i, const SymbolTable& symbols,
+                 ResultSink* sink) const;
 };
 
 }  // namespace order
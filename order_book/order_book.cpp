@@ -1,49 +1,83 @@
+#include <algorithm>
 #include <string>
-#include <functional>
 #include <stdexcept>
+#include <vector>
+#include <stats.h>
 #include "order_book.h"
 #include "order.h"
+#include "result_sink.h"
 
 namespace order
 {
 
-// templating this function on different types: min vs. max level map --> 2023 bytes with O(s)/clang 12
-// runtime changes to implement get_first_level and meets_price_req:  --> 1245 bytes with O(s)/clang 12
-static qty_t update_book(levelmap::MinLevelMap *search_levels,
-                         std::function<bool(price_t, price_t)> meets_price_req,
-                         Order *order, OrderResult *result)
+constexpr size_t kBatchPrefetch = 4;
+constexpr size_t kMaxIdleBooks = 256;
+
+/**
+ * True if a resting order at price can fill an incoming kSide order with
+ * limit price limit.
+*/
+template <OrderSide kSide>
+static inline bool crosses(price_t price, price_t limit)
+{
+  if constexpr (kSide == OrderSide::kBuy) {
+    return price <= limit;
+  } else {
+    return price >= limit;
+  }
+}
+
+/**
+ * Matches an incoming kSide order against the other side of the book,
+ * best level first. Both the side and the level order are template
+ * parameters so the price check inlines and there is no branch on side
+ * in the loop.
+*/
+template <OrderSide kSide, typename Levels>
+static qty_t update_book(Levels *search_levels, Order *order,
+                         OrderResult *result, order_index_t *index)
 {
   auto remaining_qty = order->qty;
   while (!search_levels->fifos_empty() && remaining_qty > 0) {
-    auto &[price, level] = search_levels->get_first_level(order);
-    if (!meets_price_req(price, order->price)) {
+    auto [price, level] = search_levels->best_level();
+    if (!crosses<kSide>(price, order->price)) {
       // all following prices will exceed/fall below the req
       break;
     }
 
-    while (level.size() != 0 && remaining_qty > 0) {
-      auto &candidate = level.front();
+    while (level->size() != 0 && remaining_qty > 0) {
+      auto &candidate = level->front();
       if (candidate.qty > 0) {
         auto min_fill = std::min(candidate.qty, remaining_qty);
-        result->orders.emplace_back(order->oid, order->symbol, order->side,
-                                    min_fill, price);
-        result->orders.emplace_back(candidate.oid, candidate.symbol,
-                                    candidate.side, min_fill, price);
+        result->fills.push_back(Execution{price, order->oid, candidate.oid,
+                                          order->symbol, min_fill,
+                                          order->side});
         candidate.qty -= min_fill;
         remaining_qty -= min_fill;
         search_levels->dec_counts(level, min_fill);
+        STATS_COUNT(kFills, 1);
+        if (candidate.qty == 0) {
+          --level->live_orders;
+          if (index != nullptr) {
+            // Its OID is free for reuse.
+            index->erase(candidate.oid);
+          }
+        }
+      } else {
+        STATS_COUNT(kTombstonesSkipped, 1);
       }
 
       if (candidate.qty == 0) {
         // candidate order has been exhausted, or was previously cancelled
-        level.pop_front();
+        // (only std::deque FIFOs keep cancelled orders around)
+        level->pop_front();
         // The price we pay for not looping over our FIFOs to determine
         // element count...
         search_levels->dec_size();
       }
     }
 
-    if (level.empty()) {
+    if (level->empty()) {
       // This is where we do our clean-up.
       // If the total QTY COUNTS are 0 we can erase the price level.
       //
@@ -59,29 +93,51 @@ static qty_t update_book(levelmap::MinLevelMap *search_levels,
   return order->qty = remaining_qty;
 }
 
-fifo_idx_t OrderBook::place_order(Order *order, OrderResult *result)
+OrderBook::OrderBook()
+    : buy_orders_(levelmap::ArenaAllocator<Order>(&arena_)),
+      sell_orders_(levelmap::ArenaAllocator<Order>(&arena_))
 {
-  // TODO(andres): check for optimal branch assembly...
-  std::function<bool(price_t, price_t)> compare_fn;
-  if (order->side == order::OrderSide::kBuy) {
-    compare_fn = std::less_equal<price_t>();
+}
+
+fifo_idx_t OrderBook::place_order(Order *order, OrderResult *result,
+                                  order_index_t *index)
+{
+  result->type = ResultType::kFilled;
+  if (order->side == OrderSide::kBuy) {
+    return place<OrderSide::kBuy>(order, result, index);
+  }
+  return place<OrderSide::kSell>(order, result, index);
+}
+
+template <OrderSide kSide>
+fifo_idx_t OrderBook::place(Order *order, OrderResult *result,
+                            order_index_t *index)
+{
+  qty_t remaining;
+  if constexpr (kSide == OrderSide::kBuy) {
+    remaining = update_book<kSide>(&sell_orders_, order, result, index);
   } else {
-    compare_fn = std::greater_equal<price_t>();
+    remaining = update_book<kSide>(&buy_orders_, order, result, index);
   }
-  auto search_levels =
-      (order->side == order::OrderSide::kBuy) ? &sell_orders_ : &buy_orders_;
-  auto book_levels =
-      (order->side == order::OrderSide::kBuy) ? &buy_orders_ : &sell_orders_;
-  result->type = ResultType::kFilled;
-  if (update_book(search_levels, compare_fn, order, result)) {
-    auto price = order->price;
-    auto next_idx =
-        static_cast<fifo_idx_t>(book_levels->fifo_size_with_key(price));
-    order->idx = next_idx;
-    book_levels->push_back_with_key(price, *order);
-    return next_idx;
+  if (remaining == 0) {
+    return kMaxDQIdx;
+  }
+  if constexpr (kSide == OrderSide::kBuy) {
+    order->idx = buy_orders_.push_back_with_key(order->price, *order);
+  } else {
+    order->idx = sell_orders_.push_back_with_key(order->price, *order);
+  }
+  return order->idx;
+}
+
+void OrderBook::load_level(OrderSide side, price_t price,
+                           const Order *orders, size_t n, fifo_idx_t *idxs)
+{
+  if (side == OrderSide::kBuy) {
+    buy_orders_.append_level(price, orders, n, idxs);
+  } else {
+    sell_orders_.append_level(price, orders, n, idxs);
   }
-  return kMaxDQIdx;
 }
 
 std::vector<fifo_idx_t> OrderBook::place_orders(
@@ -103,13 +159,85 @@ std::vector<fifo_idx_t> OrderBook::place_orders(
 }
 
 /**
- * Locates the order we need to kill then 0s out the quantity.
+ * Locates the order we need to kill through its FIFO handle.
+*/
+bool OrderBook::kill_order(OrderSide side, price_t price, fifo_idx_t idx,
+                           oid_t oid)
+{
+  if (side == OrderSide::kBuy) {
+    return buy_orders_.erase_order(price, idx, oid);
+  }
+  return sell_orders_.erase_order(price, idx, oid);
+}
+
+bool OrderBook::kill_order(const Order &reference_order_data)
+{
+  return kill_order(reference_order_data.side, reference_order_data.price,
+                    reference_order_data.idx, reference_order_data.oid);
+}
+
+/**
+ * A buy rests on the bids and matches against the best ask, and the other
+ * way around for a sell.
 */
-void OrderBook::kill_order(const Order &reference_order_data)
+void OrderBook::prefetch(OrderSide side, price_t price) const
+{
+  if (side == OrderSide::kBuy) {
+    sell_orders_.prefetch_best();
+    buy_orders_.prefetch(price);
+  } else {
+    buy_orders_.prefetch_best();
+    sell_orders_.prefetch(price);
+  }
+}
+
+std::pair<price_t, price_t> OrderBook::get_spread() const
 {
-  auto &levels = (reference_order_data.side == OrderSide::kBuy) ? buy_orders_
-                                                                : sell_orders_;
-  levels.zero_out_order(reference_order_data.price, reference_order_data.idx);
+  price_t best_bid = buy_orders_.map_empty() ? 0 : buy_orders_.highest_price();
+  price_t best_ask =
+      sell_orders_.map_empty() ? 0 : sell_orders_.lowest_price();
+  return {best_bid, best_ask};
+}
+
+/**
+ * Level aggregates come straight off of the LevelMap counters, nothing is
+ * walked.
+*/
+template <typename Levels>
+static LevelDepth level_depth(const Levels &levels, OrderSide side,
+                              price_t price)
+{
+  LevelDepth depth;
+  depth.price = price;
+  depth.side = side;
+  if (const auto *level = levels.find(price)) {
+    depth.qty = level->num_orders;
+    depth.orders = static_cast<uint32_t>(level->live_orders);
+  }
+  return depth;
+}
+
+LevelDepth OrderBook::level(OrderSide side, price_t price) const
+{
+  if (side == OrderSide::kBuy) {
+    return level_depth(buy_orders_, side, price);
+  }
+  return level_depth(sell_orders_, side, price);
+}
+
+BookMap::BookMap()
+    : own_symbols_(std::make_unique<SymbolTable>()),
+      symbols_(own_symbols_.get())
+{
+}
+
+BookMap::BookMap(SymbolTable *symbols) : symbols_(symbols) {}
+
+OrderResult BookMap::handle_order(Order *order)
+{
+  OrderResult result{};
+  handle_order(order, &result);
+  return result;
 }
 
 /**
@@ -117,107 +245,369 @@ void OrderBook::kill_order(const Order &reference_order_data)
  * Returns a kError if the price is bad or the oid is already
  * in flight.
 */
-OrderResult BookMap::handle_order(Order *order)
+void BookMap::handle_order(Order *order, OrderResult *result)
+{
+  result->clear();
+  place(order, result);
+}
+
+void BookMap::place(Order *order, OrderResult *result)
 {
   // check for dups
   auto curr_oid = order->oid;
-  if (order_lut_.count(curr_oid)) {
-    return OrderResult{ResultType::kError,
-                       std::to_string(curr_oid) + " Duplicate order id",
-                       {}};
+  if (order_index_.contains(curr_oid)) {
+    result->type = ResultType::kError;
+    result->error = ErrorCode::kDuplicateOid;
+    result->order = *order;
+    return;
   }
-  if (order->price <= 0.0 || order->price > order::kMaxPrice) {
-    return OrderResult{ResultType::kError,
-                       std::to_string(curr_oid) + " Invalid price, <= 0",
-                       {}};
+  if (order->price <= 0 || order->price > order::kMaxPrice) {
+    result->type = ResultType::kError;
+    result->error = ErrorCode::kInvalidPrice;
+    result->order = *order;
+    return;
   }
-  OrderResult result{};
-  auto dq_idx = book_map_[order->symbol].place_order(order, &result);
+  // Only ids the table handed out have a name to print the book under.
+  if (order->symbol >= symbols_->size()) {
+    result->type = ResultType::kError;
+    result->error = ErrorCode::kInvalidSymbol;
+    result->order = *order;
+    return;
+  }
+  if (order->symbol >= book_map_.size()) {
+    book_map_.resize(order->symbol + 1);
+  }
+  auto &book = book_map_[order->symbol];
+  if (!book) {
+    book = std::make_unique<OrderBook>();
+  } else if (book->empty()) {
+    revive(order->symbol);
+  }
+  auto dq_idx = book->place_order(order, result, &order_index_);
   if (dq_idx != kMaxDQIdx) {
-    order_lut_.emplace(curr_oid, std::move(*order));
-  } else if (book_map_[order->symbol].empty()) {
-    book_map_.erase(order->symbol);
-    // TODO(andres): erase from symbol registry if/when I implement
+    order_index_.insert(curr_oid, OrderRef{order->price, order->symbol,
+                                           dq_idx, order->side});
+  } else if (book->empty()) {
+    retire(order->symbol);
   }
+}
+
+OrderResult BookMap::cancel_order(const oid_t oid)
+{
+  OrderResult result{};
+  cancel_order(oid, &result);
   return result;
 }
 
 /**
- * Cancel order is a bit weird. We will 0-out the qty for the
- * order to be cancelled with an O(log(n)) lookup instead of destroying it.
- * (Unless the STL is doing something fancier to make .begin() of
- * a (std::map) red-black tree O(1).)
- *
- * We pay this penalty by searching through non-empty FIFOs in update_book
- * and finally popping them off if we encounter total order counts of 0.
+ * Cancel order goes straight to the order through the FIFO handle
+ * kept in the order_index_. With the default intrusive FIFOs the order
+ * is unlinked in O(1) (after an O(1) level lookup inside the tick window),
+ * nothing is left behind for update_book to skip.
  *
- * We do this to support the use of deques and HOPEFULLY a nicer
- * memory reference profile instead of linked list nodes, (which
- * would otherwise offer a nicer O(1) erase on paper).
- *
- * I'd like to try with linked lists instead of deques to see how
- * that affects performance if I have time.
+ * Building with DEQUE_FIFO keeps the old behavior: the order is 0'd out
+ * in place and popped off lazily when update_book reaches it, in
+ * exchange for the deque's denser memory reference profile.
 */
-OrderResult BookMap::cancel_order(const oid_t oid)
+void BookMap::cancel_order(const oid_t oid, OrderResult *result)
 {
-  if (order_lut_.count(oid)) {
-    auto order = order_lut_[oid];
-    // Copy out useful metadata before we erase the K,V pair.
-    auto result = OrderResult{ResultType::kCancelled, "", {order}};
-    book_map_[order.symbol].kill_order(order);
+  result->clear();
+  cancel(oid, result);
+}
+
+void BookMap::cancel(oid_t oid, OrderResult *result)
+{
+  if (const auto *found = order_index_.find(oid)) {
+    // Copy out useful metadata before we erase the index entry.
+    auto ref = *found;
     // Erase this oid, so incoming orders may now use it.
-    // The Order instance will be destroyed lazily.
-    order_lut_.erase(oid);
-    if (book_map_[order.symbol].empty()) {
-      book_map_.erase(order.symbol);
+    order_index_.erase(oid);
+    auto &book = book_map_[ref.symbol];
+    bool killed = book->kill_order(ref.side, ref.price, ref.idx, oid);
+    if (book->empty()) {
+      retire(ref.symbol);
+    }
+    if (killed) {
+      result->type = ResultType::kCancelled;
+      // Where it was, for anyone following the levels.
+      result->order = Order(oid, ref.symbol, ref.side, 0, ref.price);
+      return;
+    }
+  }
+  STATS_COUNT(kOidMisses, 1);
+  result->type = ResultType::kError;
+  result->error = ErrorCode::kInvalidOid;
+  result->order.oid = oid;
+}
+
+/**
+ * Requests run strictly in order instead of being grouped by symbol: a
+ * cancel can name an order placed earlier in the same burst on any
+ * symbol, and so can a duplicate OID check, so regrouping would change
+ * results. Prefetching gets most of what grouping would have, the next
+ * few requests' books, levels and OID slots are already in cache when
+ * their turn comes.
+*/
+void BookMap::handle_batch(std::span<const BookRequest> requests,
+                           BatchResult *out)
+{
+  out->clear();
+  out->entries.reserve(requests.size());
+  // The fills go straight into out's buffer, result only carries the rest
+  // of one request's outcome.
+  OrderResult result{};
+  result.fills.swap(out->fills);
+  auto n = requests.size();
+  for (size_t i = 0; i < std::min(n, 2 * kBatchPrefetch); ++i) {
+    prefetch_slots(requests[i]);
+  }
+  for (size_t i = 0; i < n; ++i) {
+    if (i + 2 * kBatchPrefetch < n) {
+      prefetch_slots(requests[i + 2 * kBatchPrefetch]);
     }
-    return result;
+    if (i + kBatchPrefetch < n) {
+      prefetch_levels(requests[i + kBatchPrefetch]);
+    }
+    const auto &request = requests[i];
+    auto first_fill = result.fills.size();
+    result.type = ResultType::kNop;
+    result.error = ErrorCode::kNone;
+    result.order = Order{};
+    Order order = request.order;
+    if (request.cancel) {
+      cancel(order.oid, &result);
+      order = result.order;
+    } else {
+      place(&order, &result);
+      if (result.type != ResultType::kFilled) {
+        order = result.order;
+      }
+    }
+    out->entries.push_back(BatchResult::Entry{
+        result.type, result.error, order,
+        static_cast<uint32_t>(first_fill),
+        static_cast<uint32_t>(result.fills.size() - first_fill)});
   }
-  return OrderResult{
-      ResultType::kError, "Invalid OID: " + std::to_string(oid), {}};
+  result.fills.swap(out->fills);
 }
 
-std::list<std::string> get_order_strings(std::deque<Order> *fifo, char prepend,
-                                         bool cull_zero_qty)
+void BookMap::prefetch_slots(const BookRequest &request) const
 {
-  std::list<std::string> result;
-  for (auto &o : *fifo) {
-    if (o.qty == 0 && cull_zero_qty) {
-      continue;
+  order_index_.prefetch(request.order.oid);
+  if (!request.cancel && request.order.symbol < book_map_.size()) {
+    if (const auto *book = book_map_[request.order.symbol].get()) {
+      __builtin_prefetch(&book->get_buy_orders());
+      __builtin_prefetch(&book->get_sell_orders());
     }
-    result.emplace_back(o.str(prepend));
   }
-  return result;
 }
 
-std::list<std::string> serialize_book(OrderBook &book, char prepend)
+/**
+ * A cancel's level is only known once its OID slot is in, which is what
+ * the first stage was for.
+*/
+void BookMap::prefetch_levels(const BookRequest &request) const
 {
-  std::list<std::string> result{};
-  std::list<std::string> sell_strings{};
-  std::list<std::string> buy_strings{};
-  auto sells = book.get_sell_orders();
-  for (auto it = sells.crbegin(); it != sells.crend(); ++it) {
-    auto ofifo = it->second;
-    sell_strings.splice(sell_strings.end(),
-                        get_order_strings(&ofifo.fifo, prepend, true));
+  symbol_id_t symbol = request.order.symbol;
+  OrderSide side = request.order.side;
+  price_t price = request.order.price;
+  if (request.cancel) {
+    const auto *ref = order_index_.find(request.order.oid);
+    if (ref == nullptr) {
+      return;
+    }
+    symbol = ref->symbol;
+    side = ref->side;
+    price = ref->price;
   }
-  auto buys = book.get_buy_orders();
-  for (auto it = buys.crbegin(); it != buys.crend(); ++it) {
-    auto ofifo = it->second;
-    buy_strings.splice(buy_strings.end(),
-                       get_order_strings(&ofifo.fifo, prepend, true));
+  if (symbol < book_map_.size() && book_map_[symbol]) {
+    book_map_[symbol]->prefetch(side, price);
   }
-  result.splice(result.end(), sell_strings);
-  result.splice(result.end(), buy_strings);
-  return result;
 }
 
-std::list<std::string> BookMap::serialize()
+void BookMap::set_max_idle_books(size_t n)
 {
-  std::list<std::string> result;
-  for (auto &[symbol, book] : book_map_) {
-    result.splice(result.end(), order::serialize_book(book, 'P'));
+  max_idle_books_ = n;
+  evict(n);
+}
+
+void BookMap::purge_idle_books()
+{
+  evict(0);
+  idle_.clear();
+  idle_head_ = 0;
+}
+
+/**
+ * Before idle_ grows, the entries evict went past and the stale ones are
+ * dropped once they outnumber the live ones, so idle_ stays proportional
+ * to the idle books however often books flip, at amortized O(1) a drain.
+*/
+void BookMap::retire(symbol_id_t symbol)
+{
+  if (max_idle_books_ == 0) {
+    book_map_[symbol].reset();
+    return;
+  }
+  if (symbol >= idle_since_.size()) {
+    idle_since_.resize(book_map_.size());
+  }
+  if (idle_.size() > 2 * idle_books_ + 64) {
+    idle_.erase(idle_.begin(),
+                idle_.begin() + static_cast<std::ptrdiff_t>(idle_head_));
+    idle_head_ = 0;
+    std::erase_if(idle_, [this](const auto &entry) {
+      return idle_since_[entry.first] != entry.second;
+    });
+  }
+  idle_since_[symbol] = ++drains_;
+  idle_.emplace_back(symbol, drains_);
+  ++idle_books_;
+  evict(max_idle_books_);
+}
+
+void BookMap::revive(symbol_id_t symbol)
+{
+  // Its entry in idle_ goes stale.
+  idle_since_[symbol] = 0;
+  --idle_books_;
+}
+
+void BookMap::evict(size_t keep)
+{
+  while (idle_books_ > keep) {
+    auto [symbol, drain] = idle_[idle_head_++];
+    if (idle_since_[symbol] == drain) {
+      book_map_[symbol].reset();
+      idle_since_[symbol] = 0;
+      --idle_books_;
+    }
+  }
+}
+
+std::pair<price_t, price_t> BookMap::get_spread(const symbol_t &symbol) const
+{
+  auto id = symbols_->find(symbol);
+  if (id >= book_map_.size() || !book_map_[id]) {
+    return {0, 0};
   }
+  return book_map_[id]->get_spread();
+}
+
+LevelDepth BookMap::level(symbol_id_t symbol, OrderSide side,
+                          price_t price) const
+{
+  if (symbol >= book_map_.size() || !book_map_[symbol]) {
+    LevelDepth depth;
+    depth.price = price;
+    depth.side = side;
+    return depth;
+  }
+  return book_map_[symbol]->level(side, price);
+}
+
+/**
+ * Both LevelMaps visit their best level first.
+*/
+template <typename Levels>
+static void depth_side(const Levels &levels, OrderSide side, size_t n,
+                       std::string_view symbol, ResultSink *sink)
+{
+  levels.for_each_level([&](price_t price, const auto &level) {
+    if (n == 0) {
+      return false;
+    }
+    if (!level.empty()) {
+      sink->level(LevelDepth{price, level.num_orders,
+                             static_cast<uint32_t>(level.live_orders), side},
+                  symbol);
+      --n;
+    }
+    return true;
+  });
+}
+
+void BookMap::depth(symbol_id_t symbol, size_t n, ResultSink *sink) const
+{
+  if (symbol >= book_map_.size() || !book_map_[symbol]) {
+    return;
+  }
+  const auto &book = *book_map_[symbol];
+  const auto &name = symbols_->name(symbol);
+  depth_side(book.get_buy_orders(), OrderSide::kBuy, n, name, sink);
+  depth_side(book.get_sell_orders(), OrderSide::kSell, n, name, sink);
+}
+
+template <typename Level>
+static void print_level(const Level &level, std::string_view symbol,
+                        ResultSink *sink)
+{
+  for (const auto &o : level.fifo) {
+    if (o.qty != 0) {
+      sink->book_order(o, symbol);
+    }
+  }
+}
+
+/**
+ * Sells then buys, each from the highest price down, and in FIFO order
+ * within a level. Only DEQUE_FIFO books hold qty 0 orders.
+ * A depth keeps to the best depth levels of each side. The best asks are
+ * the lowest ones, so they are found best first and printed back to
+ * front, the bids stop after depth levels.
+*/
+static void serialize_book(const OrderBook &book, std::string_view symbol,
+                           size_t depth, ResultSink *sink)
+{
+  auto print = [&](price_t, const auto &level) {
+    print_level(level, symbol, sink);
+  };
+  if (depth == 0) {
+    // Both from the highest price down: the asks are kept lowest first,
+    // the bids highest first.
+    book.get_sell_orders().rfor_each_level(print);
+    book.get_buy_orders().for_each_level(print);
+    return;
+  }
+  using AskLevel = levelmap::MinLevelMap::OQueue;
+  std::vector<const AskLevel *> asks;
+  asks.reserve(std::min(depth, book.get_sell_orders().map_size()));
+  book.get_sell_orders().for_each_level([&](price_t, const auto &level) {
+    asks.push_back(&level);
+    return asks.size() < depth;
+  });
+  for (auto it = asks.crbegin(); it != asks.crend(); ++it) {
+    print_level(**it, symbol, sink);
+  }
+  size_t bids = 0;
+  book.get_buy_orders().for_each_level([&](price_t, const auto &level) {
+    print_level(level, symbol, sink);
+    return ++bids < depth;
+  });
+}
+
+void BookMap::serialize(ResultSink *sink) const
+{
+  for (symbol_id_t id = 0; id < book_map_.size(); ++id) {
+    if (book_map_[id]) {
+      serialize_book(*book_map_[id], symbols_->name(id), 0, sink);
+    }
+  }
+}
+
+void BookMap::serialize(symbol_id_t symbol, ResultSink *sink,
+                        size_t depth) const
+{
+  if (symbol < book_map_.size() && book_map_[symbol]) {
+    serialize_book(*book_map_[symbol], symbols_->name(symbol), depth, sink);
+  }
+}
+
+std::list<std::string> BookMap::serialize() const
+{
+  std::list<std::string> result;
+  ListSink sink(&result);
+  serialize(&sink);
   return result;
 }
 
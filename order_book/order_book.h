@@ -2,54 +2,98 @@
 #define ORDER_BOOK_ORDER_BOOK_H_
 #include <cstddef>
 #include <map>
-#include <unordered_map>
+#include <memory>
 #include <queue>
 #include <numeric>
 #include <list>
+#include <span>
 #include <string>
+#include <string_view>
+#include "arena.h"
 #include "order.h"
 #include "level_map.h"
+#include "oid_index.h"
+#include "symbol_table.h"
 
 namespace order
 {
 
+struct OrderRef;
+using order_index_t = OidIndex<OrderRef>;
+
+/**
+ * How far ahead BookMap::handle_batch prefetches, in requests.
+*/
+const extern size_t kBatchPrefetch;
+/**
+ * Drained books a BookMap keeps by default, see BookMap::set_max_idle_books.
+*/
+const extern size_t kMaxIdleBooks;
+
 /**
  * There will be one OrderBook per symbol
+ * Both sides allocate from the book's own Arena.
 */
 class OrderBook
 {
  public:
-  OrderBook() = default;
+  OrderBook();
 
   /**
    * Attempts to match an inbound Order (buy or sell),
    * if a viable candidate is not found the order is placed
    * in one of buy_orders_ or sell_orders_ to be matched later.
+   * Resting orders that get filled completely are dropped from index.
+   * Returns the FIFO handle of the booked remainder or kMaxDQIdx.
   */
-  fifo_idx_t place_order(Order* order, OrderResult* result);
+  fifo_idx_t place_order(Order* order, OrderResult* result,
+                         order_index_t* index = nullptr);
 
   /**
-   * Not really used outside of tests, but should be able to batch orders.
+   * Not really used outside of tests, BookMap::handle_batch is the batch
+   * entry point.
   */
   std::vector<fifo_idx_t> place_orders(std::vector<Order>* orders,
                                        std::vector<OrderResult>* results);
 
   /**
-   * 0-out the quantity for an order in the book using its information
-   * from the order_lut_
+   * Takes an order out of the book using its side, price, and FIFO handle.
+   * Returns false if it was no longer in the book.
+  */
+  bool kill_order(OrderSide side, price_t price, fifo_idx_t idx, oid_t oid);
+  bool kill_order(const Order& order);
+
+  /**
+   * Bulk load for a snapshot: rests n orders of one side at price, in
+   * FIFO order, without matching them. Their FIFO handles go to idxs.
   */
-  void kill_order(const Order& order);
+  void load_level(OrderSide side, price_t price, const Order* orders,
+                  size_t n, fifo_idx_t* idxs);
 
   /**
-   * Returns the best offer and the best ask
+   * Cache hints ahead of a place_order(order), they change nothing: the
+   * level order would rest at and the best level it would match against.
+   * Taking side and price alone, it works for a cancel's level too.
   */
-  std::pair<price_t, price_t> get_spread();
+  void prefetch(OrderSide side, price_t price) const;
+
+  /**
+   * Returns the best offer and the best ask, O(1) off of the cached
+   * extremes in each LevelMap. A side with no orders reports 0.
+  */
+  std::pair<price_t, price_t> get_spread() const;
+
+  /**
+   * L2 aggregate of the level at price, qty and orders are 0 if there is
+   * none.
+  */
+  LevelDepth level(OrderSide side, price_t price) const;
 
   inline const levelmap::MinLevelMap& get_sell_orders() const
   {
     return sell_orders_;
   }
-  inline const levelmap::MinLevelMap& get_buy_orders() const
+  inline const levelmap::MaxLevelMap& get_buy_orders() const
   {
     return buy_orders_;
   }
@@ -104,32 +148,190 @@ class OrderBook
     return sell_orders_.map_empty();
   }
 
+  /**
+   * Bytes the book's Arena took from the heap.
+  */
+  inline size_t arena_size() const noexcept { return arena_.reserved(); }
+
  private:
-  levelmap::MinLevelMap buy_orders_;
+  /**
+   * place_order for one side, the matching loop is specialized on it.
+  */
+  template <OrderSide kSide>
+  fifo_idx_t place(Order* order, OrderResult* result, order_index_t* index);
+
+  // Declared first, both maps give their memory back to it.
+  levelmap::Arena arena_;
+  levelmap::MaxLevelMap buy_orders_;
   levelmap::MinLevelMap sell_orders_;
 };
 
+/**
+ * Books are indexed directly by symbol_id_t.
+*/
+using book_map_t = std::vector<std::unique_ptr<OrderBook>>;
+
+/**
+ * What the order_index_ keeps per resting order: just enough to reach it
+ * through its FIFO handle, instead of a whole copy of the Order.
+*/
+struct OrderRef {
+  price_t price;
+  symbol_id_t symbol;
+  fifo_idx_t idx;
+  OrderSide side;
+};
+
 /**
  * A BookMap owns one OrderBook per Symbol
 */
 class BookMap
 {
  public:
+  BookMap();
+  /**
+   * A BookMap that names its books through someone else's symbols, e.g.
+   * one of several shards fed by a single parser. symbols must outlive it.
+  */
+  explicit BookMap(SymbolTable* symbols);
+
   OrderResult handle_order(Order* order);
   OrderResult cancel_order(const oid_t oid);
-  std::list<std::string> serialize();
+  /**
+   * Same as above, but into a caller owned result that is cleared first,
+   * so one OrderResult can be reused across actions without reallocating.
+  */
+  void handle_order(Order* order, OrderResult* result);
+  void cancel_order(const oid_t oid, OrderResult* result);
+  /**
+   * Runs a burst of requests in order, exactly as if each had gone
+   * through handle_order or cancel_order, into out (cleared first): one
+   * entry per request and every fill in one buffer.
+   * Before request i runs, the OID index slots (and books) of the request
+   * 2 * kBatchPrefetch ahead and the levels of the one kBatchPrefetch
+   * ahead are prefetched, so their misses overlap with matching.
+  */
+  void handle_batch(std::span<const BookRequest> requests, BatchResult* out);
+  /**
+   * Streams every resting order to sink as a P line, books in order of
+   * symbol id (the order symbols were first seen in), so the same actions
+   * always print the same way.
+  */
+  void serialize(ResultSink* sink) const;
+  std::list<std::string> serialize() const;
+  /**
+   * Same as above for one symbol, nothing if there is no book for it.
+   * With a depth, only the orders on the best depth levels of each side.
+  */
+  void serialize(symbol_id_t symbol, ResultSink* sink,
+                 size_t depth = 0) const;
+  /**
+   * Appends a binary snapshot of every resting order to out: the symbols,
+   * then per book its bid and ask levels from the best price out, each
+   * level's orders in FIFO order. The OID index isn't written, load
+   * rebuilds it from the orders (their FIFO handles change anyway).
+   * journaled is how many journal messages the books reflect, kept in the
+   * snapshot for whoever replays a journal on top of it.
+  */
+  void save(std::string* out, uint64_t journaled = 0) const;
+  /**
+   * Fills an empty BookMap from a snapshot taken by save, level by level
+   * without matching anything. With an external SymbolTable, the symbols
+   * it already has must match the snapshot's. Sets *journaled, if given,
+   * to the count save was given.
+   * Returns false and fills err if the snapshot doesn't check out, the
+   * books are left in an unspecified state then.
+  */
+  bool load(std::string_view in, std::string* err,
+            uint64_t* journaled = nullptr);
+  /**
+   * A book that drains stays where it is, levels, FIFO nodes and Arena
+   * blocks and all, so a thinly traded symbol that keeps going empty and
+   * coming back doesn't rebuild its book every time. At most n drained
+   * books are kept (about 100KiB each once they have seen some orders),
+   * past that the one that has been idle longest is freed. 0 frees every
+   * book as soon as it drains, lowering n evicts right away.
+  */
+  void set_max_idle_books(size_t n);
+  /**
+   * Frees every drained book, e.g. at the end of the trading day.
+  */
+  void purge_idle_books();
+  size_t idle_books() const noexcept { return idle_books_; }
+  /**
+   * True while oid is resting on one of the books.
+  */
+  bool contains(oid_t oid) const { return order_index_.contains(oid); }
+  /**
+   * L1 quote for a symbol, {0, 0} if there is no book for it.
+  */
+  std::pair<price_t, price_t> get_spread(const symbol_t& symbol) const;
+  /**
+   * L2 aggregate of one level, what an incremental feed sends for every
+   * level an action touched (the fills of a result, the level an order
+   * rested at or was cancelled from). 0s once the level is gone.
+  */
+  LevelDepth level(symbol_id_t symbol, OrderSide side, price_t price) const;
+  /**
+   * Top of book snapshot: the best n levels of each side as L records,
+   * bids then asks, each from the best price out. Nothing if there is no
+   * book for symbol.
+  */
+  void depth(symbol_id_t symbol, size_t n, ResultSink* sink) const;
+
+  /**
+   * Symbols are interned when an action is parsed, so the book look-up on
+   * every order and cancel is a vector index instead of a string hash.
+  */
+  inline SymbolTable& symbols() noexcept { return *symbols_; }
+  inline const SymbolTable& symbols() const noexcept { return *symbols_; }
 
  private:
+  /**
+   * handle_order and cancel_order without clearing result first, so the
+   * fills pile up behind the ones already there.
+  */
+  void place(Order* order, OrderResult* result);
+  void cancel(oid_t oid, OrderResult* result);
+  /**
+   * The two prefetch stages of handle_batch. The first only touches
+   * things that are already in cache to find the addresses, the second
+   * goes through what the first brought in.
+  */
+  void prefetch_slots(const BookRequest& request) const;
+  void prefetch_levels(const BookRequest& request) const;
+  /**
+   * Book retention: retire when symbol's book drains, revive when an
+   * order lands on it again, evict down to keep idle books.
+  */
+  void retire(symbol_id_t symbol);
+  void revive(symbol_id_t symbol);
+  void evict(size_t keep);
+
+  std::unique_ptr<SymbolTable> own_symbols_;
+  SymbolTable* symbols_;
   // book_map_ is where we find the real orders that are in flight
-  std::unordered_map<symbol_t, OrderBook> book_map_;
+  book_map_t book_map_;
+  /**
+   * order_index_ is the rosetta stone for finding an order in the
+   * book_map_: OID -> {symbol, side, price level, FIFO handle}.
+   * It holds every resting order and nothing else, so it doubles as the
+   * duplicate OID check.
+  */
+  order_index_t order_index_;
   /**
-   * order_lut_ is the rosetta stone for finding an order in the
-   * book_map_, basically using all of that order's internal information.
-   * order_lut_ may be used to query information about the order EXCEPT
-   * QUANTITY. QUANTITY IS STALE FROM THE MOMENT THE ORDER WAS PLACED
-   * IN THE LIMIT ORDER QUEUE.
+   * Drained books, least recently drained first from idle_head_ on.
+   * idle_since_[symbol] is the drain that idled symbol's book, 0 while it
+   * is busy or gone, so entries of idle_ that don't match it are for books
+   * that were revived since, and are dropped lazily. A plain vector that
+   * is compacted in place, so it stops allocating once it has grown.
   */
-  std::unordered_map<oid_t, Order> order_lut_;
+  size_t max_idle_books_ = kMaxIdleBooks;
+  size_t idle_books_ = 0;
+  uint64_t drains_ = 0;
+  std::vector<uint64_t> idle_since_;
+  std::vector<std::pair<symbol_id_t, uint64_t>> idle_;
+  size_t idle_head_ = 0;
 };
 
 }  // namespace order
@@ -0,0 +1,347 @@
+#ifndef ORDER_BOOK_ORDER_FIFO_H_
+#define ORDER_BOOK_ORDER_FIFO_H_
+#include <cstddef>
+#include <cstdint>
+#include <bit>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace levelmap
+{
+
+/**
+ * Fixed-size node storage shared by every IntrusiveFifo of one LevelMap.
+ * Nodes are addressed by 32-bit handles so that they are cheap to store
+ * in the OID look-up, and they never move once allocated: storage grows
+ * in chunks and released nodes go onto a free list for reuse.
+ * Chunks double from kFirstChunkSize nodes up to kMaxChunkSize, so a book
+ * that only ever sees a few orders stays small, and a node's value is only
+ * constructed while it is allocated.
+*/
+template <typename Value, typename Alloc>
+class NodePool
+{
+ public:
+  using handle_t = uint32_t;
+  static constexpr handle_t kNil = std::numeric_limits<handle_t>::max();
+
+  struct Node {
+    alignas(Value) unsigned char storage[sizeof(Value)];
+    handle_t prev;
+    handle_t next;
+
+    Value& value() { return *std::launder(reinterpret_cast<Value*>(storage)); }
+    const Value& value() const
+    {
+      return *std::launder(reinterpret_cast<const Value*>(storage));
+    }
+  };
+
+  explicit NodePool(const Alloc& alloc = Alloc()) : alloc_(alloc) {}
+  NodePool(const NodePool&) = delete;
+  NodePool& operator=(const NodePool&) = delete;
+  ~NodePool()
+  {
+    for (size_t c = 0; c < chunks_.size(); ++c) {
+      auto first = static_cast<handle_t>(chunk_start(c));
+      for (size_t i = 0; i < chunk_size(c); ++i) {
+        if (contains(first + static_cast<handle_t>(i))) {
+          std::destroy_at(&chunks_[c][i].value());
+        }
+      }
+      NodeAllocTraits::deallocate(alloc_, chunks_[c], chunk_size(c));
+    }
+  }
+
+  template <typename... Args>
+  handle_t allocate(Args&&... args)
+  {
+    if (free_ == kNil) {
+      grow();
+    }
+    handle_t handle = free_;
+    Node& node = (*this)[handle];
+    free_ = node.next;
+    std::construct_at(&node.value(), std::forward<Args>(args)...);
+    node.prev = kNil;
+    node.next = kNil;
+    ++live_;
+    return handle;
+  }
+
+  void release(handle_t handle)
+  {
+    Node& node = (*this)[handle];
+    std::destroy_at(&node.value());
+    node.prev = kReleased;
+    node.next = free_;
+    free_ = handle;
+    --live_;
+  }
+
+  /**
+   * True if handle refers to a node that is currently allocated.
+  */
+  bool contains(handle_t handle) const
+  {
+    return handle < capacity_ && (*this)[handle].prev != kReleased;
+  }
+
+  Node& operator[](handle_t handle)
+  {
+    auto [chunk, offset] = locate(handle);
+    return chunks_[chunk][offset];
+  }
+
+  const Node& operator[](handle_t handle) const
+  {
+    auto [chunk, offset] = locate(handle);
+    return chunks_[chunk][offset];
+  }
+
+  size_t size() const noexcept { return live_; }
+  size_t capacity() const noexcept { return capacity_; }
+
+ private:
+  using NodeAlloc =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+  using NodeAllocTraits = std::allocator_traits<NodeAlloc>;
+  using ChunkAlloc =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<Node*>;
+  static constexpr handle_t kReleased = kNil - 1;
+  static constexpr size_t kFirstChunkShift = 6;
+  static constexpr size_t kFirstChunkSize = size_t{1} << kFirstChunkShift;
+  static constexpr size_t kMaxChunkShift = 12;
+  static constexpr size_t kMaxChunkSize = size_t{1} << kMaxChunkShift;
+  // The first kDoublings chunks add up to kMaxChunkSize nodes.
+  static constexpr size_t kDoublings = kMaxChunkShift - kFirstChunkShift + 1;
+
+  /**
+   * Chunks 0 and 1 hold kFirstChunkSize nodes and every chunk after that
+   * twice as many as the one before, up to kMaxChunkSize. That way chunk
+   * c > 0 starts at handle kFirstChunkSize << (c - 1) until the chunks
+   * stop growing.
+  */
+  static size_t chunk_size(size_t c)
+  {
+    return (c < kDoublings)
+               ? kFirstChunkSize << (c == 0 ? 0 : c - 1)
+               : kMaxChunkSize;
+  }
+  static size_t chunk_start(size_t c)
+  {
+    if (c == 0) {
+      return 0;
+    }
+    return (c < kDoublings)
+               ? kFirstChunkSize << (c - 1)
+               : (c - kDoublings + 1) * kMaxChunkSize;
+  }
+  static std::pair<size_t, size_t> locate(handle_t handle)
+  {
+    if (handle < kMaxChunkSize) {
+      auto width = static_cast<size_t>(
+          std::bit_width(handle | (kFirstChunkSize - 1)));
+      size_t chunk = width - kFirstChunkShift;
+      return {chunk, handle - chunk_start(chunk)};
+    }
+    return {kDoublings - 1 + (handle >> kMaxChunkShift),
+            handle & (kMaxChunkSize - 1)};
+  }
+
+  void grow()
+  {
+    size_t c = chunks_.size();
+    size_t n = chunk_size(c);
+    Node* chunk = NodeAllocTraits::allocate(alloc_, n);
+    auto first = static_cast<handle_t>(capacity_);
+    chunks_.push_back(chunk);
+    capacity_ += n;
+    // Thread the new nodes onto the free list in ascending order so that
+    // consecutive allocations are adjacent in memory.
+    for (size_t i = 0; i < n; ++i) {
+      chunk[i].prev = kReleased;
+      chunk[i].next =
+          (i + 1 < n) ? first + static_cast<handle_t>(i + 1) : free_;
+    }
+    free_ = first;
+  }
+
+  NodeAlloc alloc_;
+  std::vector<Node*, ChunkAlloc> chunks_{ChunkAlloc(alloc_)};
+  size_t capacity_ = 0;
+  handle_t free_ = kNil;
+  size_t live_ = 0;
+};
+
+/**
+ * A doubly-linked FIFO of pool allocated nodes.
+ * Unlike std::deque any element can be unlinked in O(1) through the handle
+ * returned by push_back, so cancels take orders out of the FIFO right away
+ * instead of leaving a 0-qty tombstone for the matcher to skip.
+ *
+ * Fits the FifoContainer template parameter of LevelMap, which detects
+ * pool_type and hands every FIFO the pool it should allocate from.
+*/
+template <typename Value, typename Alloc = std::allocator<Value>>
+class IntrusiveFifo
+{
+ public:
+  using value_type = Value;
+  using pool_type = NodePool<Value, Alloc>;
+  using handle_t = typename pool_type::handle_t;
+  static constexpr handle_t kNil = pool_type::kNil;
+
+  class const_iterator
+  {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Value;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Value*;
+    using reference = const Value&;
+
+    const_iterator() = default;
+    const_iterator(const pool_type* pool, handle_t handle)
+        : pool_(pool), handle_(handle)
+    {
+    }
+    reference operator*() const { return (*pool_)[handle_].value(); }
+    pointer operator->() const { return &(*pool_)[handle_].value(); }
+    const_iterator& operator++()
+    {
+      handle_ = (*pool_)[handle_].next;
+      return *this;
+    }
+    const_iterator operator++(int)
+    {
+      auto prev = *this;
+      ++*this;
+      return prev;
+    }
+    bool operator==(const const_iterator& other) const
+    {
+      return handle_ == other.handle_;
+    }
+    bool operator!=(const const_iterator& other) const
+    {
+      return !(*this == other);
+    }
+    handle_t handle() const { return handle_; }
+
+   private:
+    const pool_type* pool_ = nullptr;
+    handle_t handle_ = kNil;
+  };
+
+  explicit IntrusiveFifo(pool_type* pool) : pool_(pool) {}
+  IntrusiveFifo(const IntrusiveFifo&) = delete;
+  IntrusiveFifo& operator=(const IntrusiveFifo&) = delete;
+  ~IntrusiveFifo() { clear(); }
+
+  handle_t push_back(const Value& v) { return link_back(pool_->allocate(v)); }
+
+  template <typename... Args>
+  handle_t emplace_back(Args&&... args)
+  {
+    return link_back(pool_->allocate(std::forward<Args>(args)...));
+  }
+
+  Value& front() { return (*pool_)[head_].value(); }
+  const Value& front() const { return (*pool_)[head_].value(); }
+  Value& back() { return (*pool_)[tail_].value(); }
+  const Value& back() const { return (*pool_)[tail_].value(); }
+
+  void pop_front() { erase(head_); }
+
+  /**
+   * Unlinks and releases the node behind handle.
+   * The handle must belong to this FIFO.
+  */
+  void erase(handle_t handle)
+  {
+    auto& node = (*pool_)[handle];
+    if (node.prev != kNil) {
+      (*pool_)[node.prev].next = node.next;
+    } else {
+      head_ = node.next;
+    }
+    if (node.next != kNil) {
+      (*pool_)[node.next].prev = node.prev;
+    } else {
+      tail_ = node.prev;
+    }
+    pool_->release(handle);
+    --size_;
+  }
+
+  /**
+   * Access to an element by handle, nullptr if the handle is not live.
+  */
+  Value* find(handle_t handle)
+  {
+    return pool_->contains(handle) ? &(*pool_)[handle].value() : nullptr;
+  }
+
+  void clear()
+  {
+    while (head_ != kNil) {
+      erase(head_);
+    }
+  }
+
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+  const_iterator begin() const { return {pool_, head_}; }
+  const_iterator end() const { return {pool_, kNil}; }
+
+ private:
+  handle_t link_back(handle_t handle)
+  {
+    auto& node = (*pool_)[handle];
+    node.prev = tail_;
+    if (tail_ != kNil) {
+      (*pool_)[tail_].next = handle;
+    } else {
+      head_ = handle;
+    }
+    tail_ = handle;
+    ++size_;
+    return handle;
+  }
+
+  pool_type* pool_;
+  handle_t head_ = kNil;
+  handle_t tail_ = kNil;
+  size_t size_ = 0;
+};
+
+/**
+ * FIFOs that expose a pool_type want one shared pool per LevelMap.
+*/
+template <typename Fifo, typename = void>
+struct fifo_traits {
+  static constexpr bool kIntrusive = false;
+  struct pool_type {
+    template <typename Alloc>
+    explicit pool_type(const Alloc&)
+    {
+    }
+  };
+};
+
+template <typename Fifo>
+struct fifo_traits<Fifo, std::void_t<typename Fifo::pool_type>> {
+  static constexpr bool kIntrusive = true;
+  using pool_type = typename Fifo::pool_type;
+};
+
+}  // namespace levelmap
+
+#endif  // ORDER_BOOK_ORDER_FIFO_H_
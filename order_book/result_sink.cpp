@@ -0,0 +1,185 @@
+#include <cerrno>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unistd.h>
+#include "result_sink.h"
+
+namespace order
+{
+
+constexpr size_t kFlushSize = size_t{1} << 16;
+
+OutputBuffer::OutputBuffer(int fd) : fd_(fd)
+{
+  if (fd_ >= 0) {
+    // Room for the longest record we might append past the threshold.
+    buffer_.reserve(2 * kFlushSize);
+  }
+}
+
+OutputBuffer::~OutputBuffer()
+{
+  try {
+    flush();
+  } catch (...) {
+    // The barrier refused, these results must not go out, or the write
+    // failed with nobody left to tell. Flush first to hear about it.
+  }
+}
+
+void OutputBuffer::put_uint(uint64_t value)
+{
+  char digits[20];
+  auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+  (void)ec;
+  buffer_.append(digits, static_cast<size_t>(end - digits));
+}
+
+void OutputBuffer::put_price(price_t price)
+{
+  put_uint(static_cast<uint64_t>(price / kPriceScale));
+  buffer_.push_back('.');
+  char digits[20];
+  auto [end, ec] = std::to_chars(digits, digits + sizeof(digits),
+                                 static_cast<uint64_t>(price % kPriceScale));
+  (void)ec;
+  auto len = static_cast<size_t>(end - digits);
+  if (len < kPriceDecimals) {
+    buffer_.append(kPriceDecimals - len, '0');
+  }
+  buffer_.append(digits, len);
+}
+
+void OutputBuffer::flush()
+{
+  if (fd_ < 0 || buffer_.empty()) {
+    return;
+  }
+  if (barrier_) {
+    barrier_();
+  }
+  const char *data = buffer_.data();
+  size_t remaining = buffer_.size();
+  while (remaining > 0) {
+    ssize_t n = ::write(fd_, data, remaining);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // Nobody left to read it (e.g. EPIPE), drop it and say so.
+      auto error = errno;
+      buffer_.clear();
+      throw std::system_error(error, std::generic_category(), "write");
+    }
+    data += n;
+    remaining -= static_cast<size_t>(n);
+  }
+  buffer_.clear();
+}
+
+void BufferSink::line(std::string_view text)
+{
+  out_->append(text);
+  end_line();
+}
+
+void BufferSink::fill(const Order &order, std::string_view symbol)
+{
+  out_->append("F ");
+  out_->put_uint(order.oid);
+  out_->push_back(' ');
+  out_->append(symbol);
+  out_->push_back(' ');
+  out_->put_uint(order.qty);
+  out_->push_back(' ');
+  out_->put_price(order.price);
+  end_line();
+}
+
+void BufferSink::cancel(oid_t oid)
+{
+  out_->append("X ");
+  out_->put_uint(oid);
+  end_line();
+}
+
+void BufferSink::error(ErrorCode code, oid_t oid)
+{
+  // Errors are rare enough to go through a std::string.
+  out_->append("E ");
+  out_->append(error_message(code, oid));
+  end_line();
+}
+
+void BufferSink::book_order(const Order &order, std::string_view symbol)
+{
+  out_->append("P ");
+  out_->put_uint(order.oid);
+  out_->push_back(' ');
+  out_->append(symbol);
+  out_->push_back(' ');
+  out_->push_back(static_cast<char>(order.side));
+  out_->push_back(' ');
+  out_->put_uint(order.qty);
+  out_->push_back(' ');
+  out_->put_price(order.price);
+  end_line();
+}
+
+void BufferSink::level(const LevelDepth &depth, std::string_view symbol)
+{
+  out_->append("L ");
+  out_->append(symbol);
+  out_->push_back(' ');
+  out_->push_back(static_cast<char>(depth.side));
+  out_->push_back(' ');
+  out_->put_uint(depth.qty);
+  out_->push_back(' ');
+  out_->put_uint(depth.orders);
+  out_->push_back(' ');
+  out_->put_price(depth.price);
+  end_line();
+}
+
+void ListSink::take_line()
+{
+  auto text = line_.view();
+  out_->emplace_back(text.substr(0, text.size() - 1));
+  line_.clear();
+}
+
+void ListSink::line(std::string_view text) { out_->emplace_back(text); }
+
+void ListSink::fill(const Order &order, std::string_view symbol)
+{
+  format_.fill(order, symbol);
+  take_line();
+}
+
+void ListSink::cancel(oid_t oid)
+{
+  format_.cancel(oid);
+  take_line();
+}
+
+void ListSink::error(ErrorCode code, oid_t oid)
+{
+  format_.error(code, oid);
+  take_line();
+}
+
+void ListSink::book_order(const Order &order, std::string_view symbol)
+{
+  format_.book_order(order, symbol);
+  take_line();
+}
+
+void ListSink::level(const LevelDepth &depth, std::string_view symbol)
+{
+  format_.level(depth, symbol);
+  take_line();
+}
+
+}  // namespace order
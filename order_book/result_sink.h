@@ -0,0 +1,171 @@
+#ifndef ORDER_BOOK_RESULT_SINK_H_
+#define ORDER_BOOK_RESULT_SINK_H_
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string>
+#include <string_view>
+#include <utility>
+#include "order.h"
+
+namespace order
+{
+
+const extern size_t kFlushSize;
+
+/**
+ * Receives results as they are produced, one call per output line.
+*/
+class ResultSink
+{
+ public:
+  virtual ~ResultSink() = default;
+
+  /**
+   * A line that is already formatted, e.g. a text parse error.
+  */
+  virtual void line(std::string_view text) = 0;
+  /**
+   * F <oid> <symbol> <qty> <price>
+  */
+  virtual void fill(const Order& order, std::string_view symbol) = 0;
+  /**
+   * X <oid>
+  */
+  virtual void cancel(oid_t oid) = 0;
+  /**
+   * E <error_message(code, oid)>
+  */
+  virtual void error(ErrorCode code, oid_t oid) = 0;
+  /**
+   * P <oid> <symbol> <side> <qty> <price>, one per resting order.
+  */
+  virtual void book_order(const Order& order, std::string_view symbol) = 0;
+  /**
+   * L <symbol> <side> <qty> <orders> <price>, one per L2 level, see
+   * BookMap::level and BookMap::depth.
+  */
+  virtual void level(const LevelDepth& depth, std::string_view symbol) = 0;
+};
+
+/**
+ * One reusable buffer that write(2)s itself to fd once a record pushes it
+ * past kFlushSize bytes, and on flush/destruction.
+ * Without an fd it just accumulates, see view() and clear().
+ * A write barrier (see set_write_barrier) runs before every write(2), so
+ * e.g. a write-ahead journal can be committed before the results of the
+ * actions it holds go out.
+*/
+class OutputBuffer
+{
+ public:
+  explicit OutputBuffer(int fd = -1);
+  ~OutputBuffer();
+  OutputBuffer(const OutputBuffer&) = delete;
+  OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+  void append(std::string_view bytes) { buffer_.append(bytes); }
+  void push_back(char c) { buffer_.push_back(c); }
+  void put_uint(uint64_t value);
+  /**
+   * Whole ticks, '.', then kPriceDecimals zero padded decimals, the same as
+   * Order::str. Prices on the book are always > 0.
+  */
+  void put_price(price_t price);
+  /**
+   * Call once a whole record is in the buffer.
+  */
+  void end_record()
+  {
+    if (fd_ >= 0 && buffer_.size() >= kFlushSize) {
+      flush();
+    }
+  }
+  /**
+   * Throws std::system_error if the write(2) fails, what wasn't written
+   * is dropped.
+  */
+  void flush();
+  /**
+   * barrier runs before each write(2) of the buffer. If it throws, nothing
+   * is written and the exception goes on to whoever appended or flushed;
+   * the destructor drops the buffer then. barrier must stay callable for
+   * as long as this is, an empty one turns it off.
+  */
+  void set_write_barrier(std::function<void()> barrier)
+  {
+    barrier_ = std::move(barrier);
+  }
+
+  std::string_view view() const noexcept { return buffer_; }
+  bool empty() const noexcept { return buffer_.empty(); }
+  void clear() noexcept { buffer_.clear(); }
+
+ private:
+  int fd_;
+  std::string buffer_;
+  std::function<void()> barrier_;
+};
+
+/**
+ * Formats text lines straight into an OutputBuffer, numbers and 7.5 prices
+ * go through std::to_chars.
+*/
+class BufferSink : public ResultSink
+{
+ public:
+  explicit BufferSink(OutputBuffer* out) : out_(out) {}
+
+  void line(std::string_view text) override;
+  void fill(const Order& order, std::string_view symbol) override;
+  void cancel(oid_t oid) override;
+  void error(ErrorCode code, oid_t oid) override;
+  void book_order(const Order& order, std::string_view symbol) override;
+  void level(const LevelDepth& depth, std::string_view symbol) override;
+
+  OutputBuffer* buffer() noexcept { return out_; }
+
+ private:
+  void end_line()
+  {
+    out_->push_back('\n');
+    out_->end_record();
+  }
+
+  OutputBuffer* out_;
+};
+
+/**
+ * Collects each line into its own string, for tests and anything else
+ * that wants the results as a list. Lines are formatted by a BufferSink,
+ * so they are exactly what the engine writes, less the newline.
+*/
+class ListSink : public ResultSink
+{
+ public:
+  explicit ListSink(std::list<std::string>* out) : out_(out), format_(&line_)
+  {
+  }
+
+  void line(std::string_view text) override;
+  void fill(const Order& order, std::string_view symbol) override;
+  void cancel(oid_t oid) override;
+  void error(ErrorCode code, oid_t oid) override;
+  void book_order(const Order& order, std::string_view symbol) override;
+  void level(const LevelDepth& depth, std::string_view symbol) override;
+
+ private:
+  /**
+   * Moves the line format_ just wrote into out_.
+  */
+  void take_line();
+
+  std::list<std::string>* out_;
+  OutputBuffer line_;
+  BufferSink format_;
+};
+
+}  // namespace order
+
+#endif  // ORDER_BOOK_RESULT_SINK_H_
@@ -0,0 +1,239 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "order_book.h"
+#include "order.h"
+#include "symbol_table.h"
+
+namespace order
+{
+
+/**
+ * Snapshot layout, all integers little-endian:
+ *
+ *   "SCSNAP02"                            8 bytes
+ *   u64 journal messages the books cover
+ *   u32 symbols, then per symbol id:      u8 length, name
+ *   u32 books, then per book:             u32 symbol id,
+ *     bids then asks:                     u32 levels, then per level:
+ *       i64 price, u32 orders, then per order:  u32 oid, u16 qty
+ *
+ * Levels go from the best price out, orders in FIFO order. Tombstones
+ * (std::deque FIFOs) are skipped, so every order has a live qty.
+*/
+constexpr std::string_view kSnapshotMagic("SCSNAP02", 8);
+
+template <typename T>
+static void put_le(T value, std::string *out)
+{
+  using U = std::make_unsigned_t<T>;
+  auto bits = static_cast<U>(value);
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    out->push_back(static_cast<char>((bits >> (8 * i)) & 0xFFU));
+  }
+}
+
+/**
+ * Fills in a count that was written as a placeholder at out[at].
+*/
+static void patch_u32(uint32_t value, size_t at, std::string *out)
+{
+  for (size_t i = 0; i < sizeof(value); ++i) {
+    (*out)[at + i] = static_cast<char>((value >> (8 * i)) & 0xFFU);
+  }
+}
+
+/**
+ * Walks a snapshot, every read past the end fails and so do all of the
+ * reads after it.
+*/
+class SnapshotReader
+{
+ public:
+  explicit SnapshotReader(std::string_view in) : rest_(in) {}
+
+  template <typename T>
+  T get()
+  {
+    using U = std::make_unsigned_t<T>;
+    if (failed_ || rest_.size() < sizeof(T)) {
+      failed_ = true;
+      return T{};
+    }
+    U bits = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+      auto byte = static_cast<U>(static_cast<unsigned char>(rest_[i]));
+      bits = static_cast<U>(bits | (byte << (8 * i)));
+    }
+    rest_.remove_prefix(sizeof(T));
+    return static_cast<T>(bits);
+  }
+
+  std::string_view bytes(size_t n)
+  {
+    if (failed_ || rest_.size() < n) {
+      failed_ = true;
+      return {};
+    }
+    auto result = rest_.substr(0, n);
+    rest_.remove_prefix(n);
+    return result;
+  }
+
+  bool failed() const noexcept { return failed_; }
+  bool done() const noexcept { return rest_.empty(); }
+
+ private:
+  std::string_view rest_;
+  bool failed_ = false;
+};
+
+template <typename Levels>
+static void save_side(const Levels &levels, std::string *out)
+{
+  auto count_at = out->size();
+  put_le(uint32_t{0}, out);
+  uint32_t count = 0;
+  levels.for_each_level([&](price_t price, const auto &level) {
+    if (level.empty()) {
+      return;
+    }
+    put_le(price, out);
+    auto orders_at = out->size();
+    put_le(uint32_t{0}, out);
+    uint32_t orders = 0;
+    for (const auto &o : level.fifo) {
+      if (o.qty != 0) {
+        put_le(o.oid, out);
+        put_le(o.qty, out);
+        ++orders;
+      }
+    }
+    patch_u32(orders, orders_at, out);
+    ++count;
+  });
+  patch_u32(count, count_at, out);
+}
+
+void BookMap::save(std::string *out, uint64_t journaled) const
+{
+  out->append(kSnapshotMagic);
+  put_le(journaled, out);
+  put_le(static_cast<uint32_t>(symbols_->size()), out);
+  for (symbol_id_t id = 0; id < symbols_->size(); ++id) {
+    const auto &name = symbols_->name(id);
+    put_le(static_cast<uint8_t>(name.size()), out);
+    out->append(name);
+  }
+  auto books_at = out->size();
+  put_le(uint32_t{0}, out);
+  uint32_t books = 0;
+  for (symbol_id_t id = 0; id < book_map_.size(); ++id) {
+    // Drained books that are being kept around have nothing to save.
+    if (!book_map_[id] || book_map_[id]->empty()) {
+      continue;
+    }
+    put_le(id, out);
+    save_side(book_map_[id]->get_buy_orders(), out);
+    save_side(book_map_[id]->get_sell_orders(), out);
+    ++books;
+  }
+  patch_u32(books, books_at, out);
+}
+
+bool BookMap::load(std::string_view in, std::string *err,
+                   uint64_t *journaled)
+{
+  if (order_index_.size() != 0) {
+    *err = "snapshot: books are not empty";
+    return false;
+  }
+  // Any books left are drained ones being kept around, start without them.
+  purge_idle_books();
+  SnapshotReader reader(in);
+  if (reader.bytes(kSnapshotMagic.size()) != kSnapshotMagic) {
+    *err = "snapshot: not a snapshot";
+    return false;
+  }
+  auto covered = reader.get<uint64_t>();
+  auto num_symbols = reader.get<uint32_t>();
+  for (symbol_id_t id = 0; id < num_symbols && !reader.failed(); ++id) {
+    auto name = reader.bytes(reader.get<uint8_t>());
+    if (!reader.failed() && name.size() > kMaxSymbolSize) {
+      *err = "snapshot: symbol " + std::string(name) + " is too long";
+      return false;
+    }
+    if (!reader.failed() && symbols_->intern(name) != id) {
+      *err = "snapshot: symbol " + std::string(name) + " has another id";
+      return false;
+    }
+  }
+  auto num_books = reader.get<uint32_t>();
+  std::vector<Order> orders;
+  std::vector<fifo_idx_t> idxs;
+  for (uint32_t b = 0; b < num_books && !reader.failed(); ++b) {
+    auto symbol = reader.get<symbol_id_t>();
+    if (!reader.failed() && symbol >= num_symbols) {
+      *err = "snapshot: unknown symbol id " + std::to_string(symbol);
+      return false;
+    }
+    if (symbol >= book_map_.size()) {
+      book_map_.resize(symbol + 1);
+    }
+    auto &book = book_map_[symbol];
+    if (!book) {
+      book = std::make_unique<OrderBook>();
+    }
+    for (auto side : {OrderSide::kBuy, OrderSide::kSell}) {
+      auto num_levels = reader.get<uint32_t>();
+      for (uint32_t l = 0; l < num_levels && !reader.failed(); ++l) {
+        auto price = reader.get<price_t>();
+        auto num_orders = reader.get<uint32_t>();
+        if (!reader.failed() &&
+            (price <= 0 || price > kMaxPrice || num_orders == 0)) {
+          *err = "snapshot: bad level " + std::to_string(price);
+          return false;
+        }
+        orders.clear();
+        for (uint32_t o = 0; o < num_orders && !reader.failed(); ++o) {
+          auto oid = reader.get<oid_t>();
+          auto qty = reader.get<qty_t>();
+          if (!reader.failed() &&
+              (qty == 0 || order_index_.contains(oid))) {
+            *err = "snapshot: bad order " + std::to_string(oid);
+            return false;
+          }
+          orders.emplace_back(oid, symbol, side, qty, price);
+          // Taken, so a duplicate inside this level is caught too.
+          order_index_.insert(oid, OrderRef{price, symbol, kMaxDQIdx, side});
+        }
+        if (reader.failed()) {
+          break;
+        }
+        idxs.resize(orders.size());
+        book->load_level(side, price, orders.data(), orders.size(),
+                         idxs.data());
+        for (size_t i = 0; i < orders.size(); ++i) {
+          order_index_.insert(orders[i].oid,
+                              OrderRef{price, symbol, idxs[i], side});
+        }
+      }
+    }
+    if (book->empty()) {
+      book.reset();
+    }
+  }
+  if (reader.failed() || !reader.done()) {
+    *err = "snapshot: truncated or malformed";
+    return false;
+  }
+  if (journaled != nullptr) {
+    *journaled = covered;
+  }
+  return true;
+}
+
+}  // namespace order
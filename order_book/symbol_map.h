@@ -0,0 +1,177 @@
+#ifndef ORDER_BOOK_SYMBOL_MAP_H_
+#define ORDER_BOOK_SYMBOL_MAP_H_
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <string_view>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif  // __SSE2__
+#include "order.h"
+
+namespace order
+{
+
+/**
+ * A symbol of at most kMaxSymbolSize (8) chars packed into one integer,
+ * char i in byte i and zeroes past the end, so two symbols compare with
+ * one integer compare instead of a string compare.
+*/
+using symbol_key_t = uint64_t;
+
+inline symbol_key_t pack_symbol(std::string_view symbol)
+{
+  symbol_key_t key = 0;
+  std::memcpy(&key, symbol.data(), std::min(symbol.size(), sizeof(key)));
+  return key;
+}
+
+/**
+ * Open-addressing symbol_key_t -> symbol_id_t map, after the SwissTable
+ * layout: slots come in groups of 16, each with a control byte holding 7
+ * bits of its key's hash (or kEmpty), and a look-up compares the control
+ * bytes of a whole group against the hash at once (SSE2, or a plain loop
+ * without it) before it looks at a single key. A hit is usually one group
+ * and one key compare, all in two or three cache lines.
+ *
+ * Symbols are never erased, so there are no tombstones to deal with. The
+ * table doubles at 7/8 full.
+*/
+class FlatSymbolMap
+{
+ public:
+  FlatSymbolMap() { rehash(kGroupSize); }
+
+  /**
+   * kInvalidSymbol if key isn't there.
+  */
+  symbol_id_t find(symbol_key_t key) const
+  {
+    auto hash = mix(key);
+    auto h2 = static_cast<uint8_t>(hash & 0x7FU);
+    auto g = group_of(hash);
+    for (size_t step = 1;; g = (g + step++) & group_mask_) {
+      const uint8_t* ctrl = &ctrl_[g * kGroupSize];
+      for (auto hits = match(ctrl, h2); hits != 0; hits &= hits - 1) {
+        const auto& slot = slots_[g * kGroupSize + lowest_bit(hits)];
+        if (slot.key == key) {
+          return slot.id;
+        }
+      }
+      if (match(ctrl, kEmpty) != 0) {
+        return kInvalidSymbol;
+      }
+    }
+  }
+
+  /**
+   * key must not be there yet.
+  */
+  void insert(symbol_key_t key, symbol_id_t id)
+  {
+    if ((size_ + 1) * 8 > slots_.size() * 7) {
+      rehash(slots_.size() * 2);
+    }
+    place(key, id);
+    ++size_;
+  }
+
+  size_t size() const noexcept { return size_; }
+  size_t capacity() const noexcept { return slots_.size(); }
+
+ private:
+  static constexpr size_t kGroupSize = 16;
+  static constexpr uint8_t kEmpty = 0x80;
+
+  struct Slot {
+    symbol_key_t key;
+    symbol_id_t id;
+  };
+
+  /**
+   * murmur3's 64-bit finalizer, packed symbols differ mostly in their low
+   * bytes and every bit of the key has to reach both halves of the hash.
+  */
+  static uint64_t mix(uint64_t h)
+  {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  size_t group_of(uint64_t hash) const
+  {
+    return static_cast<size_t>(hash >> 7) & group_mask_;
+  }
+
+  static size_t lowest_bit(uint32_t bits)
+  {
+    return static_cast<size_t>(std::countr_zero(bits));
+  }
+
+  /**
+   * Bit i is set if control byte i of the group is value.
+  */
+  static uint32_t match(const uint8_t* ctrl, uint8_t value)
+  {
+#ifdef __SSE2__
+    auto group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+    auto eq = _mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(value)));
+    return static_cast<uint32_t>(_mm_movemask_epi8(eq));
+#else
+    uint32_t bits = 0;
+    for (size_t i = 0; i < kGroupSize; ++i) {
+      bits |= static_cast<uint32_t>(ctrl[i] == value) << i;
+    }
+    return bits;
+#endif  // __SSE2__
+  }
+
+  /**
+   * Into the first empty slot of key's probe sequence (groups visited
+   * 1, 2, 3, ... apart, which covers every group of a power of two).
+  */
+  void place(symbol_key_t key, symbol_id_t id)
+  {
+    auto hash = mix(key);
+    auto g = group_of(hash);
+    for (size_t step = 1;; g = (g + step++) & group_mask_) {
+      auto empty = match(&ctrl_[g * kGroupSize], kEmpty);
+      if (empty != 0) {
+        auto i = g * kGroupSize + lowest_bit(empty);
+        ctrl_[i] = static_cast<uint8_t>(hash & 0x7FU);
+        slots_[i] = Slot{key, id};
+        return;
+      }
+    }
+  }
+
+  void rehash(size_t capacity)
+  {
+    std::vector<uint8_t> old_ctrl(capacity, kEmpty);
+    std::vector<Slot> old_slots(capacity);
+    old_ctrl.swap(ctrl_);
+    old_slots.swap(slots_);
+    group_mask_ = capacity / kGroupSize - 1;
+    for (size_t i = 0; i < old_ctrl.size(); ++i) {
+      if (old_ctrl[i] != kEmpty) {
+        place(old_slots[i].key, old_slots[i].id);
+      }
+    }
+  }
+
+  std::vector<uint8_t> ctrl_;
+  std::vector<Slot> slots_;
+  size_t group_mask_ = 0;
+  size_t size_ = 0;
+};
+
+}  // namespace order
+
+#endif  // ORDER_BOOK_SYMBOL_MAP_H_
@@ -0,0 +1,50 @@
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include "symbol_table.h"
+
+namespace order
+{
+
+SymbolTable::SymbolTable()
+    : chunks_(std::make_unique<std::unique_ptr<symbol_t[]>[]>(kMaxChunks))
+{
+}
+
+symbol_id_t SymbolTable::intern(std::string_view symbol)
+{
+  if (symbol.size() > kMaxSymbolSize) {
+    throw std::length_error("Symbol longer than kMaxSymbolSize");
+  }
+  auto key = pack_symbol(symbol);
+  auto found = ids_.find(key);
+  if (found != kInvalidSymbol) {
+    return found;
+  }
+  auto size = size_.load(std::memory_order_relaxed);
+  auto chunk = size >> kChunkShift;
+  if (chunk == kMaxChunks) {
+    throw std::length_error("SymbolTable is full");
+  }
+  if (!chunks_[chunk]) {
+    chunks_[chunk] = std::make_unique<symbol_t[]>(kChunkSize);
+  }
+  auto id = static_cast<symbol_id_t>(size);
+  auto& name = chunks_[chunk][id & kChunkMask];
+  name = symbol;
+  ids_.insert(key, id);
+  // Published only now, readers of size() may name() the id right away.
+  size_.store(size + 1, std::memory_order_release);
+  return id;
+}
+
+symbol_id_t SymbolTable::find(std::string_view symbol) const
+{
+  if (symbol.size() > kMaxSymbolSize) {
+    return kInvalidSymbol;
+  }
+  return ids_.find(pack_symbol(symbol));
+}
+
+}  // namespace order
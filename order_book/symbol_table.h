@@ -0,0 +1,66 @@
+#ifndef ORDER_BOOK_SYMBOL_TABLE_H_
+#define ORDER_BOOK_SYMBOL_TABLE_H_
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "order.h"
+#include "symbol_map.h"
+
+namespace order
+{
+
+/**
+ * Interns symbols into dense ids once, at parse time, so that everything
+ * downstream (Order, OrderRef, BookMap's book look-up) carries a 4-byte
+ * symbol_id_t instead of hashing and copying a std::string.
+ * Ids are handed out in order of first appearance and are never recycled.
+ *
+ * Names live in fixed chunks that never move, so one thread can intern
+ * while others call name() on ids that were handed to them after they
+ * were interned (e.g. through a queue), or size(). intern() and find()
+ * themselves are single-threaded.
+*/
+class SymbolTable
+{
+ public:
+  SymbolTable();
+
+  /**
+   * Returns the id for symbol, registering it if it's new. Symbols are
+   * looked up by their packed symbol_key_t, so one longer than
+   * kMaxSymbolSize throws std::length_error.
+  */
+  symbol_id_t intern(std::string_view symbol);
+
+  /**
+   * Returns the id for symbol or kInvalidSymbol if it was never interned
+   * (or can't be, being too long).
+  */
+  symbol_id_t find(std::string_view symbol) const;
+
+  const symbol_t& name(symbol_id_t id) const
+  {
+    return chunks_[id >> kChunkShift][id & kChunkMask];
+  }
+
+  /**
+   * Ids below size() have been issued, and their names written.
+  */
+  size_t size() const noexcept { return size_.load(std::memory_order_acquire); }
+
+ private:
+  static constexpr size_t kChunkShift = 12;
+  static constexpr size_t kChunkSize = size_t{1} << kChunkShift;
+  static constexpr size_t kChunkMask = kChunkSize - 1;
+  static constexpr size_t kMaxChunks = size_t{1} << 12;
+
+  std::unique_ptr<std::unique_ptr<symbol_t[]>[]> chunks_;
+  std::atomic<size_t> size_{0};
+  FlatSymbolMap ids_;
+};
+
+}  // namespace order
+
+#endif  // ORDER_BOOK_SYMBOL_TABLE_H_
@@ -0,0 +1,105 @@
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <iostream>
+#include <unistd.h>
+#include <order.h>
+#include <result_sink.h>
+#include <symbol_table.h>
+#include "ingest.h"
+#include "simple_cross.h"
+#include "wire.h"
+
+/**
+ * sc_convert translates between simple_cross's text and binary formats:
+ *   encode  text actions (e.g. actions.txt) -> wire::Message actions
+ *   decode  wire::Message results -> the text simple_cross would print
+ * Lines the text parser rejects have no binary form, they are skipped and
+ * counted on stderr.
+*/
+static void usage(const char *argv0)
+{
+  std::cerr << "usage: " << argv0 << " encode|decode [FILE]\n"
+            << "  encode  text actions to binary actions\n"
+            << "  decode  binary results to text results\n"
+            << "  Reads FILE, or stdin if FILE is - or missing, and writes "
+               "to stdout.\n";
+}
+
+static int encode(ingest::LineSource *source)
+{
+  order::SymbolTable symbols;
+  order::OutputBuffer out(STDOUT_FILENO);
+  results_t err;
+  size_t skipped = 0;
+  ingest::line_batch_t batch;
+  while (source->next_batch(&batch)) {
+    for (auto line : batch) {
+      err.clear();
+      auto action = deserialize_action(line, &err, &symbols);
+      wire::Message msg;
+      if (!err.empty()) {
+        ++skipped;
+      } else if (wire::encode_action(action, symbols, &msg)) {
+        wire::put(msg, &out);
+      }
+    }
+  }
+  out.flush();
+  if (skipped > 0) {
+    std::cerr << "skipped " << skipped << " invalid lines\n";
+  }
+  return 0;
+}
+
+static int decode(ingest::LineSource *source)
+{
+  order::OutputBuffer out(STDOUT_FILENO);
+  order::BufferSink sink(&out);
+  ingest::line_batch_t batch;
+  while (source->next_batch(&batch)) {
+    for (auto bytes : batch) {
+      if (bytes.size() != wire::kMessageSize) {
+        std::cerr << "truncated message at the end of the input\n";
+        return 1;
+      }
+      wire::replay_result(wire::decode(bytes.data()), &sink);
+    }
+  }
+  out.flush();
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2 || argc > 3) {
+    usage(argv[0]);
+    return 1;
+  }
+  std::string_view command(argv[1]);
+  if (command != "encode" && command != "decode") {
+    usage(argv[0]);
+    return 1;
+  }
+  std::string path = (argc == 3) ? argv[2] : "-";
+  std::string err;
+  auto source =
+      ingest::open_source(path, ingest::Mode::kMmap, &err,
+                          (command == "decode") ? wire::kMessageSize : 0);
+  if (!source) {
+    std::cerr << err << '\n';
+    return 1;
+  }
+  int rc = 0;
+  try {
+    rc = (command == "encode") ? encode(source.get()) : decode(source.get());
+  } catch (const std::system_error &e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+  }
+  if (!source->error().empty()) {
+    std::cerr << path << ": " << source->error() << '\n';
+    return 1;
+  }
+  return rc;
+}
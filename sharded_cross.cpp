@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <variant>
+#include <vector>
+#include <order_book.h>
+#include <order.h>
+#include <result_sink.h>
+#include <stats.h>
+#include "journal.h"
+#include "sharded_cross.h"
+#include "simple_cross.h"
+#include "wire.h"
+
+constexpr size_t kMaxShards = 64;
+
+OidOwners::OidOwners()
+    : pages_(std::make_unique<std::unique_ptr<std::atomic<uint32_t>[]>[]>(
+          kPages))
+{
+}
+
+void OidOwners::claim(order::oid_t oid, size_t shard)
+{
+  auto& page = pages_[oid >> kPageShift];
+  if (!page) {
+    page = std::make_unique<std::atomic<uint32_t>[]>(kPageSize);
+  }
+  auto& owner = page[oid & kPageMask];
+  if (claims_of(owner.load(std::memory_order_acquire)) == 0) {
+    // Nobody else can touch an OID without claims.
+    owner.store((static_cast<uint32_t>(shard) << kShardShift) | 1,
+                std::memory_order_relaxed);
+  } else {
+    owner.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+ShardedCross::Shard::Shard(order::SymbolTable* symbols)
+    : queue(kQueueSize), books(symbols)
+{
+  result.fills.reserve(order::kReservedFills);
+}
+
+ShardedCross::ShardedCross(size_t shards, Format format,
+                           order::OutputBuffer* out)
+    : format_(format),
+      out_(out),
+      out_sink_(make_sink(out)),
+      slots_(std::make_unique<Slot[]>(kSlots))
+{
+  for (size_t i = 0; i < kSlots; ++i) {
+    slots_[i].sink = make_sink(&slots_[i].out);
+  }
+  shards = std::clamp<size_t>(shards, 1, kMaxShards);
+  for (size_t i = 0; i < shards; ++i) {
+    shards_.push_back(std::make_unique<Shard>(&symbols_));
+  }
+  for (auto& shard : shards_) {
+    shard->worker = std::thread(&ShardedCross::run, this, shard.get());
+  }
+}
+
+ShardedCross::~ShardedCross()
+{
+  // Unwinding, say from a failed journal commit, nothing more may be
+  // written: only stop the workers. finish() writes through the same
+  // barrier, so if it failed before it would most likely fail again.
+  if (std::uncaught_exceptions() == 0) {
+    try {
+      finish();
+    } catch (const std::system_error&) {
+      // Whoever saw it first already had the chance to report it.
+    }
+  }
+  for (auto& shard : shards_) {
+    while (!shard->queue.try_push(Task{kStop, NopAction{}})) {
+      std::this_thread::yield();
+    }
+  }
+  for (auto& shard : shards_) {
+    shard->worker.join();
+  }
+}
+
+std::unique_ptr<order::ResultSink> ShardedCross::make_sink(
+    order::OutputBuffer* out)
+{
+  if (format_ == Format::kBinary) {
+    return std::make_unique<wire::BinarySink>(out);
+  }
+  return std::make_unique<order::BufferSink>(out);
+}
+
+/**
+ * Worker loop. Besides handling the action it releases the OID claims of
+ * orders that are no longer resting: the order itself if it was rejected
+ * or filled right away, and any resting order it filled completely.
+*/
+void ShardedCross::run(Shard* shard)
+{
+  Task task;
+  while (true) {
+    shard->queue.pop(&task, kIdleSpins);
+    if (task.seq == kStop) {
+      return;
+    }
+    // Parsing happened on the dispatcher, only match and format are timed.
+    stats::ActionTimer timer;
+    auto& out = slot(task.seq);
+    auto& result = shard->result;
+    handle_action(&task.action, &shard->books, &result, out.sink.get(),
+                  &timer);
+    if (auto* place = std::get_if<PlaceOrderAction>(&task.action)) {
+      auto oid = place->order.oid;
+      if (result.type == order::ResultType::kError ||
+          !shard->books.contains(oid)) {
+        owners_.release(oid);
+      }
+      if (result.type == order::ResultType::kFilled) {
+        for (const auto& e : result.fills) {
+          if (!shard->books.contains(e.resting)) {
+            owners_.release(e.resting);
+          }
+        }
+      }
+    } else if (result.type == order::ResultType::kCancelled) {
+      owners_.release(result.order.oid);
+    }
+    out.ready.store(true, std::memory_order_release);
+    shard->done.fetch_add(1, std::memory_order_release);
+  }
+}
+
+void ShardedCross::actions(const std::vector<std::string_view>& lines)
+{
+  for (auto line : lines) {
+    err_.clear();
+    auto action = deserialize_action(line, &err_, &symbols_);
+    if (!err_.empty()) {
+      auto& out = slot(next_seq());
+      for (const auto& err : err_) {
+        out.sink->line(err);
+      }
+      out.ready.store(true, std::memory_order_release);
+      continue;
+    }
+    dispatch(&action);
+  }
+  if (journal_ != nullptr) {
+    journal_->commit();
+  }
+  write_ready();
+}
+
+void ShardedCross::messages(const std::vector<std::string_view>& messages)
+{
+  for (auto bytes : messages) {
+    order::ErrorCode error;
+    order::oid_t oid;
+    auto action = wire::decode_action(bytes, &symbols_, &error, &oid);
+    if (error != order::ErrorCode::kNone) {
+      auto& out = slot(next_seq());
+      out.sink->error(error, oid);
+      out.ready.store(true, std::memory_order_release);
+      continue;
+    }
+    dispatch(&action);
+  }
+  if (journal_ != nullptr) {
+    journal_->commit();
+  }
+  write_ready();
+}
+
+void ShardedCross::finish() { drain_all(); }
+
+bool ShardedCross::recover(const std::string& path, size_t* records,
+                           std::string* err)
+{
+  discard_ = true;
+  auto ok = journal::replay(
+      path, [this](const ingest::line_batch_t& batch) { messages(batch); },
+      0, records, err);
+  finish();
+  discard_ = false;
+  return ok;
+}
+
+/**
+ * Routes one parsed action. See the class comment for how OIDs that are
+ * reused across shards are handled.
+*/
+void ShardedCross::dispatch(Action* action)
+{
+  if (journal_ != nullptr) {
+    journal_->append(*action, symbols_);
+  }
+  if (auto* place = std::get_if<PlaceOrderAction>(action)) {
+    auto oid = place->order.oid;
+    size_t shard = place->order.symbol % shards_.size();
+    auto owner = owners_.load(oid);
+    if (OidOwners::claims_of(owner) > 0 &&
+        OidOwners::shard_of(owner) != shard) {
+      // Once the owner has caught up its claims are exact.
+      drain(OidOwners::shard_of(owner));
+      owner = owners_.load(oid);
+      if (OidOwners::claims_of(owner) > 0) {
+        // Still resting there, let that shard reject the duplicate.
+        shard = OidOwners::shard_of(owner);
+      }
+    }
+    owners_.claim(oid, shard);
+    send(shard, next_seq(), action);
+  } else if (auto* cancel = std::get_if<CancelOrderAction>(action)) {
+    auto owner = owners_.load(cancel->oid);
+    auto seq = next_seq();
+    if (OidOwners::claims_of(owner) == 0) {
+      // Not resting anywhere.
+      auto& out = slot(seq);
+      out.sink->error(order::ErrorCode::kInvalidOid, cancel->oid);
+      out.ready.store(true, std::memory_order_release);
+    } else {
+      send(OidOwners::shard_of(owner), seq, action);
+    }
+  } else if (const auto* print_action = std::get_if<PrintAction>(action)) {
+    stats::ActionTimer timer;
+    if (print_action->key == 0) {
+      print();
+    } else if (print_action->symbol != order::kInvalidSymbol) {
+      print(*print_action);
+    }
+    timer.lap(stats::Phase::kFormat);
+    timer.done(stats::ActionType::kPrint);
+  }
+}
+
+uint64_t ShardedCross::next_seq()
+{
+  while (next_seq_ - written_ >= kSlots) {
+    write_ready();
+    if (next_seq_ - written_ >= kSlots) {
+      std::this_thread::yield();
+    }
+  }
+  return next_seq_++;
+}
+
+void ShardedCross::send(size_t shard, uint64_t seq, Action* action)
+{
+  auto& target = *shards_[shard];
+  while (!target.queue.try_push(Task{seq, *action})) {
+    write_ready();
+    std::this_thread::yield();
+  }
+  ++target.sent;
+}
+
+void ShardedCross::drain(size_t shard)
+{
+  const auto& target = *shards_[shard];
+  while (target.done.load(std::memory_order_acquire) != target.sent) {
+    write_ready();
+    std::this_thread::yield();
+  }
+}
+
+void ShardedCross::drain_all()
+{
+  for (size_t shard = 0; shard < shards_.size(); ++shard) {
+    drain(shard);
+  }
+  write_ready();
+}
+
+/**
+ * A barrier: with every shard caught up the dispatcher can read all the
+ * books itself, in symbol id order like BookMap::serialize.
+*/
+void ShardedCross::print()
+{
+  drain_all();
+  for (order::symbol_id_t id = 0; id < symbols_.size(); ++id) {
+    shards_[id % shards_.size()]->books.serialize(id, out_sink_.get());
+  }
+}
+
+/**
+ * The best levels of one book only need its own shard to catch up. Their
+ * lines go to the print's own slot, so the other shards keep matching
+ * meanwhile. A whole book could be any size, so like P it waits for
+ * everyone and streams to out instead of piling up in a slot.
+*/
+void ShardedCross::print(const PrintAction& action)
+{
+  size_t shard = action.symbol % shards_.size();
+  if (action.depth == 0) {
+    drain_all();
+    shards_[shard]->books.serialize(action.symbol, out_sink_.get());
+    return;
+  }
+  auto seq = next_seq();
+  drain(shard);
+  auto& out = slot(seq);
+  shards_[shard]->books.serialize(action.symbol, out.sink.get(),
+                                  action.depth);
+  out.ready.store(true, std::memory_order_release);
+}
+
+void ShardedCross::write_ready()
+{
+  while (written_ != next_seq_) {
+    auto& out = slot(written_);
+    if (!out.ready.load(std::memory_order_acquire)) {
+      return;
+    }
+    if (!out.out.empty() && !discard_) {
+      out_->append(out.out.view());
+      out_->end_record();
+    }
+    out.out.clear();
+    out.ready.store(false, std::memory_order_relaxed);
+    ++written_;
+  }
+}
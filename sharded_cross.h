@@ -0,0 +1,197 @@
+#ifndef SHARDED_CROSS_H_
+#define SHARDED_CROSS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <order_book.h>
+#include <order.h>
+#include <result_sink.h>
+#include <spsc_queue.h>
+#include <symbol_table.h>
+#include "journal.h"
+#include "simple_cross.h"
+
+const extern size_t kMaxShards;
+
+/**
+ * Which shard may be holding an OID, shared between the dispatcher and the
+ * workers of a ShardedCross.
+ *
+ * Every OID has one atomic word: the shard in the top 8 bits and, below
+ * that, how many orders sent to that shard with this OID may still be
+ * resting (claims). The dispatcher claims an OID when it sends an order
+ * and the worker releases the claim once the order is rejected, filled, or
+ * cancelled. All the claims on an OID belong to the same shard at any one
+ * time, the dispatcher makes sure of that.
+ * Pages are only ever allocated by the dispatcher, before it hands the OID
+ * to a worker.
+*/
+class OidOwners
+{
+ public:
+  OidOwners();
+
+  /**
+   * Dispatcher only.
+  */
+  uint32_t load(order::oid_t oid) const
+  {
+    const auto* page = pages_[oid >> kPageShift].get();
+    return page ? page[oid & kPageMask].load(std::memory_order_acquire) : 0;
+  }
+  void claim(order::oid_t oid, size_t shard);
+
+  /**
+   * Worker only, for an OID it holds a claim on.
+  */
+  void release(order::oid_t oid)
+  {
+    pages_[oid >> kPageShift][oid & kPageMask].fetch_sub(
+        1, std::memory_order_release);
+  }
+
+  static size_t shard_of(uint32_t owner) { return owner >> kShardShift; }
+  static uint32_t claims_of(uint32_t owner) { return owner & kClaimsMask; }
+
+ private:
+  static constexpr size_t kPageShift = 16;
+  static constexpr size_t kPageSize = size_t{1} << kPageShift;
+  static constexpr size_t kPageMask = kPageSize - 1;
+  static constexpr size_t kPages = size_t{1} << (32 - kPageShift);
+  static constexpr uint32_t kShardShift = 24;
+  static constexpr uint32_t kClaimsMask = (uint32_t{1} << kShardShift) - 1;
+
+  std::unique_ptr<std::unique_ptr<std::atomic<uint32_t>[]>[]> pages_;
+};
+
+/**
+ * Runs the same actions as SimpleCross with the books split by symbol
+ * across worker threads, and writes exactly the same output.
+ *
+ * The calling thread is the dispatcher: it parses every action, numbers
+ * it, and sends it over a SpscQueue to the worker that owns the symbol's
+ * shard, or for a cancel to the shard OidOwners says holds the OID. Each
+ * worker has its own BookMap and formats its results into the output slot
+ * of the action's number; the dispatcher copies finished slots to out
+ * strictly in action order. Actions on one symbol are handled in order by
+ * one worker, so fills come out exactly as they would single-threaded.
+ *
+ * OIDs are global though. An order that reuses an OID another shard may
+ * still be holding waits for that shard to catch up before it's routed,
+ * and goes to that shard to be rejected as a duplicate if it is resting.
+ * P waits for every shard to catch up and prints from the dispatcher,
+ * P SYMBOL N only waits for the symbol's shard.
+*/
+class ShardedCross
+{
+ public:
+  enum class Format {
+    kText,
+    kBinary,
+  };
+
+  /**
+   * shards worker threads, between 1 and kMaxShards, writing format
+   * results to out.
+  */
+  ShardedCross(size_t shards, Format format, order::OutputBuffer* out);
+  /**
+   * Stops the workers, after a finish() unless an exception is unwinding.
+   * Call finish() first to hear about a failed write.
+  */
+  ~ShardedCross();
+  ShardedCross(const ShardedCross&) = delete;
+  ShardedCross& operator=(const ShardedCross&) = delete;
+
+  void actions(const std::vector<std::string_view>& lines);
+  void messages(const std::vector<std::string_view>& messages);
+  /**
+   * Waits for every action so far and writes its results to out.
+  */
+  void finish();
+
+  /**
+   * Journals every parsed order and cancel from now on, committed once
+   * per batch. journal must outlive this. For results not to get out ahead
+   * of the journal, out must commit it first, see
+   * OutputBuffer::set_write_barrier.
+  */
+  void set_journal(journal::Journal* journal) { journal_ = journal; }
+  /**
+   * Rebuilds the books from the journal at path, the results of the
+   * replayed actions are dropped. Call before anything else.
+  */
+  bool recover(const std::string& path, size_t* records, std::string* err);
+
+ private:
+  static constexpr size_t kSlots = size_t{1} << 12;
+  static constexpr size_t kQueueSize = size_t{1} << 10;
+  // Empty polls before an idle worker goes to sleep on its queue.
+  static constexpr size_t kIdleSpins = 1024;
+  static constexpr uint64_t kStop = ~uint64_t{0};
+
+  struct Task {
+    uint64_t seq;
+    Action action;
+  };
+
+  struct Slot {
+    order::OutputBuffer out;
+    std::unique_ptr<order::ResultSink> sink;
+    std::atomic<bool> ready{false};
+  };
+
+  struct Shard {
+    explicit Shard(order::SymbolTable* symbols);
+
+    SpscQueue<Task> queue;
+    order::BookMap books;
+    order::OrderResult result;
+    // Tasks sent, only touched by the dispatcher.
+    uint64_t sent = 0;
+    alignas(64) std::atomic<uint64_t> done{0};
+    std::thread worker;
+  };
+
+  std::unique_ptr<order::ResultSink> make_sink(order::OutputBuffer* out);
+  void run(Shard* shard);
+
+  /**
+   * Dispatcher side.
+  */
+  void dispatch(Action* action);
+  /**
+   * Waits for a free output slot and returns its action number.
+  */
+  uint64_t next_seq();
+  Slot& slot(uint64_t seq) { return slots_[seq & (kSlots - 1)]; }
+  void send(size_t shard, uint64_t seq, Action* action);
+  void drain(size_t shard);
+  void drain_all();
+  void print();
+  void print(const PrintAction& action);
+  void write_ready();
+
+  Format format_;
+  order::OutputBuffer* out_;
+  std::unique_ptr<order::ResultSink> out_sink_;
+  order::SymbolTable symbols_;
+  OidOwners owners_;
+  std::unique_ptr<Slot[]> slots_;
+  // Next action number and the first one not yet written to out_.
+  uint64_t next_seq_ = 0;
+  uint64_t written_ = 0;
+  results_t err_;
+  journal::Journal* journal_ = nullptr;
+  // Finished slots are dropped instead of written, while recovering.
+  bool discard_ = false;
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+#endif  // SHARDED_CROSS_H_
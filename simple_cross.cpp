@@ -1,53 +1,118 @@
-#include <unordered_map>
-#include <sstream>
-#include <iomanip>
 #include <algorithm>
-#include <memory>
 #include <cctype>
-#include <functional>
-#include <unordered_set>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <variant>
 #include <order_book.h>
 #include <order.h>
-#include <log.h>
+#include <stats.h>
+#include <symbol_table.h>
+#include "journal.h"
 #include "simple_cross.h"
+#include "wire.h"
 
-static std::unordered_set<std::string> kAllowableActionTokens{"O", "X", "P"};
-static std::unordered_set<char> kAllowableSides{'B', 'S'};
-static size_t kInvalidSubstringSize = 10LU;
-
-struct OrderAction : public Action {
-  explicit OrderAction(uint32_t oid) : oid(oid) {}
-  uint32_t oid;
-};
+/**
+ * Walks a line the way `std::stringstream >>` would, without copying it:
+ * every extraction skips leading whitespace first, and once one fails
+ * all of the following ones fail too.
+*/
+class Tokenizer
+{
+ public:
+  explicit Tokenizer(std::string_view line) : rest_(line) {}
 
-struct PlaceOrderAction : public OrderAction {
-  order::symbol_t symbol;
-  order::Order order;
+  /**
+   * Next run of non-whitespace characters, empty once we run out.
+  */
+  std::string_view token()
+  {
+    skip_whitespace();
+    if (failed_ || rest_.empty()) {
+      failed_ = true;
+      return {};
+    }
+    size_t len = 0;
+    while (len < rest_.size() && !is_space(rest_[len])) {
+      ++len;
+    }
+    auto result = rest_.substr(0, len);
+    rest_.remove_prefix(len);
+    return result;
+  }
 
-  PlaceOrderAction(uint32_t oid, order::symbol_t symbol, order::Order order)
-      : OrderAction(oid), symbol(symbol), order(order)
+  /**
+   * Next non-whitespace character, '\0' once we run out.
+  */
+  char character()
   {
+    skip_whitespace();
+    if (failed_ || rest_.empty()) {
+      failed_ = true;
+      return '\0';
+    }
+    char c = rest_.front();
+    rest_.remove_prefix(1);
+    return c;
   }
 
-  virtual results_t handle_action(order::BookMap* books) override final
+  /**
+   * Leading [+-]digits of the next token, which may run straight into the
+   * token after it. Like std::num_get, a '-' wraps around, a missing number
+   * reads as 0, and one that doesn't fit saturates (and fails the rest).
+  */
+  order::oid_t oid()
   {
-    return books->handle_order(&order).serialize();
+    skip_whitespace();
+    if (failed_) {
+      return 0;
+    }
+    bool negative = false;
+    if (!rest_.empty() && (rest_.front() == '-' || rest_.front() == '+')) {
+      negative = (rest_.front() == '-');
+      rest_.remove_prefix(1);
+    }
+    constexpr uint64_t kMax = std::numeric_limits<order::oid_t>::max();
+    uint64_t value = 0;
+    size_t num_digits = 0;
+    for (; !rest_.empty() && is_digit(rest_.front()); ++num_digits) {
+      if (value <= kMax) {
+        value = value * 10 + static_cast<uint64_t>(rest_.front() - '0');
+      }
+      rest_.remove_prefix(1);
+    }
+    if (num_digits == 0) {
+      failed_ = true;
+      return 0;
+    }
+    if (value > kMax) {
+      failed_ = true;
+      return static_cast<order::oid_t>(kMax);
+    }
+    auto oid = static_cast<order::oid_t>(value);
+    return negative ? static_cast<order::oid_t>(0U - oid) : oid;
   }
-};
 
-struct CancelOrderAction : public OrderAction {
-  explicit CancelOrderAction(uint32_t oid) : OrderAction(oid) {}
-  virtual results_t handle_action(order::BookMap* books) override final
+ private:
+  static bool is_space(char c)
   {
-    return books->cancel_order(oid).serialize();
+    return std::isspace(static_cast<unsigned char>(c));
+  }
+  static bool is_digit(char c)
+  {
+    return std::isdigit(static_cast<unsigned char>(c));
   }
-};
 
-struct PrintAction : public Action {
-  virtual results_t handle_action(order::BookMap* books) override final
+  void skip_whitespace()
   {
-    return books->serialize();
+    while (!rest_.empty() && is_space(rest_.front())) {
+      rest_.remove_prefix(1);
+    }
   }
+
+  std::string_view rest_;
+  bool failed_ = false;
 };
 
 /**
@@ -56,118 +121,365 @@ struct PrintAction : public Action {
  * X 10002
  * P
  */
-static inline bool is_whitespace(const std::string& line)
+static inline bool is_whitespace(std::string_view line)
 {
   return std::all_of(line.cbegin(), line.cend(), [](const char& c) {
     return std::isspace(static_cast<unsigned char>(c));
   });
 }
 
-static inline bool valid_symbol(const order::symbol_t& sym)
+static inline bool valid_symbol(std::string_view sym)
 {
   if (sym.size() == 0 || sym.size() > order::kMaxSymbolSize) {
     return false;
   }
   return std::find_if(sym.cbegin(), sym.cend(), [](const auto& c) {
-           return !std::isalnum(c);
+           return !std::isalnum(static_cast<unsigned char>(c));
          }) == sym.end();
 }
 
-static inline bool valid_qty_format(const std::string& qty_str)
+static inline bool valid_qty_format(std::string_view qty_str)
 {
-  return std::find_if(qty_str.cbegin(), qty_str.cend(), [](const auto& c) {
-           return !std::isdigit(c);
+  return !qty_str.empty() &&
+         std::find_if(qty_str.cbegin(), qty_str.cend(), [](const auto& c) {
+           return !std::isdigit(static_cast<unsigned char>(c));
          }) == qty_str.end();
 }
 
-std::unique_ptr<Action> Action::deserialize(const std::string& action_string,
-                                            results_t* err)
+/**
+ * Digits only (see valid_qty_format), saturates instead of overflowing.
+*/
+static inline size_t parse_qty(std::string_view qty_str)
+{
+  constexpr size_t kMax = std::numeric_limits<size_t>::max();
+  size_t qty = 0;
+  for (char c : qty_str) {
+    auto digit = static_cast<size_t>(c - '0');
+    qty = (qty > (kMax - digit) / 10) ? kMax : qty * 10 + digit;
+  }
+  return qty;
+}
+
+/**
+ * Parses a 7.5 format decimal straight into fixed-point ticks.
+ * Digits past the fifth decimal place round half up.
+ * Returns false for anything that isn't [+-]digits[.digits].
+ */
+static inline bool parse_price(std::string_view price_str,
+                               order::price_t* price)
+{
+  auto it = price_str.cbegin();
+  bool negative = false;
+  if (it != price_str.cend() && (*it == '-' || *it == '+')) {
+    negative = (*it == '-');
+    ++it;
+  }
+  order::price_t whole = 0;
+  size_t num_digits = 0;
+  auto is_digit = [](char c) {
+    return std::isdigit(static_cast<unsigned char>(c));
+  };
+  for (; it != price_str.cend() && is_digit(*it); ++it, ++num_digits) {
+    if (whole <= order::kMaxPrice) {
+      whole = whole * 10 + (*it - '0');
+    }
+  }
+  order::price_t fraction = 0;
+  order::price_t scale = order::kPriceScale;
+  if (it != price_str.cend() && *it == '.') {
+    for (++it; it != price_str.cend() && is_digit(*it); ++it, ++num_digits) {
+      if (scale > 1) {
+        scale /= 10;
+        fraction += (*it - '0') * scale;
+      } else if (scale == 1) {
+        fraction += (*it >= '5') ? 1 : 0;
+        scale = 0;
+      }
+    }
+  }
+  if (num_digits == 0 || it != price_str.cend()) {
+    return false;
+  }
+  order::price_t ticks = (whole > order::kMaxPrice)
+                             ? order::kMaxPrice + 1
+                             : whole * order::kPriceScale + fraction;
+  *price = negative ? -ticks : ticks;
+  return true;
+}
+
+/**
+ * The rest of P SYMBOL [N]. The symbol is only looked up, see PrintAction,
+ * but kept by name so a print for a symbol without a book can still be
+ * encoded as a wire::Message. It just prints nothing.
+*/
+static Action deserialize_print(Tokenizer* tokens,
+                                std::string_view action_string,
+                                results_t* err, order::SymbolTable* symbols)
+{
+  auto symbol = tokens->token();
+  if (symbol.empty()) {
+    err->emplace_back("Invalid Print Action request size: " +
+                      std::string(action_string) + "...");
+    return NopAction{};
+  }
+  if (!valid_symbol(symbol)) {
+    err->emplace_back("Invalid Symbol: " + std::string(symbol));
+    return NopAction{};
+  }
+  PrintAction print;
+  auto depth_str = tokens->token();
+  if (depth_str.empty()) {
+    print.key = order::pack_symbol(symbol);
+    print.symbol = symbols->find(symbol);
+    return print;
+  }
+  size_t depth = valid_qty_format(depth_str) ? parse_qty(depth_str) : 0;
+  if (depth == 0 || depth > std::numeric_limits<uint16_t>::max()) {
+    err->emplace_back("Invalid Print Action depth: " +
+                      std::string(depth_str));
+    return NopAction{};
+  }
+  if (!tokens->token().empty()) {
+    err->emplace_back("Invalid Print Action request size: " +
+                      std::string(action_string) + "...");
+    return NopAction{};
+  }
+  print.key = order::pack_symbol(symbol);
+  print.symbol = symbols->find(symbol);
+  print.depth = static_cast<uint16_t>(depth);
+  return print;
+}
+
+Action deserialize_action(std::string_view action_string, results_t* err,
+                          order::SymbolTable* symbols)
 {
   if (action_string.size() == 0 || is_whitespace(action_string)) {
-    return std::make_unique<Action>();
-  }
-  std::stringstream astream(action_string);
-  std::string type;
-  astream >> type;
-  if (!kAllowableActionTokens.count(type)) {
-    err->emplace_back("Invalid action: " +
-                      action_string.substr(0, std::max(kInvalidSubstringSize,
-                                                       action_string.size())) +
+    return NopAction{};
+  }
+  Tokenizer tokens(action_string);
+  auto type = tokens.token();
+  if (type != "O" && type != "X" && type != "P") {
+    err->emplace_back("Invalid action: " + std::string(action_string) +
                       "...");
+    return NopAction{};
   }
 
   if (type == "P") {
     if (action_string.size() == 1) {
-      return std::make_unique<PrintAction>();
+      return PrintAction{};
     }
-    err->emplace_back("Invalid Print Action request size: " +
-                      action_string.substr(0, std::max(kInvalidSubstringSize,
-                                                       action_string.size())) +
-                      "...");
-    return std::make_unique<Action>();
+    return deserialize_print(&tokens, action_string, err, symbols);
 
   } else if (type == "O") {
-    order::oid_t oid;
-    astream >> oid;
+    order::oid_t oid = tokens.oid();
 
-    order::symbol_t symbol;
-    astream >> symbol;
+    auto symbol = tokens.token();
     if (!valid_symbol(symbol)) {
-      err->emplace_back("Invalid Symbol: " + symbol);
-      return std::make_unique<Action>();
+      err->emplace_back("Invalid Symbol: " + std::string(symbol));
+      return NopAction{};
     }
 
-    char side_char;
-    astream >> side_char;
-    if (!kAllowableSides.count(side_char)) {
-      err->emplace_back(std::to_string(oid) + " Invalid order side: " + type);
-      return std::make_unique<Action>();
+    char side_char = tokens.character();
+    if (side_char != 'B' && side_char != 'S') {
+      err->emplace_back(std::to_string(oid) + " Invalid order side: " +
+                        std::string(type));
+      return NopAction{};
     }
 
     order::OrderSide side =
         (side_char == 'B') ? order::OrderSide::kBuy : order::OrderSide::kSell;
 
-    std::string qty_str;
-    astream >> qty_str;
+    auto qty_str = tokens.token();
     if (!valid_qty_format(qty_str)) {
-      err->emplace_back(
-          std::to_string(oid) + " Invalid quantity format: " +
-          qty_str.substr(0, std::max(qty_str.size(), kInvalidSubstringSize)));
-      return std::make_unique<Action>();
+      err->emplace_back(std::to_string(oid) + " Invalid quantity format: " +
+                        std::string(qty_str));
+      return NopAction{};
     }
-    size_t qty = std::stoul(qty_str);
+    size_t qty = parse_qty(qty_str);
     if (qty == 0 || qty > order::kMaxQuantity) {
       err->emplace_back(std::to_string(oid) +
                         " Quantity out of valid range: " + std::to_string(qty));
-      return std::make_unique<Action>();
+      return NopAction{};
     }
 
-    std::string price_str;
-    astream >> price_str;
-    order::price_t price = std::stod(price_str);
-    if (price <= 0.0 || price > order::kMaxPrice) {
+    order::price_t price = 0;
+    if (!parse_price(tokens.token(), &price) || price <= 0 ||
+        price > order::kMaxPrice) {
       err->emplace_back(std::to_string(oid) +
                         " Price <= 0 || > 9999999.99999 ");
-      return std::make_unique<Action>();
+      return NopAction{};
+    }
+    // Only orders that made it this far get a symbol id.
+    return PlaceOrderAction{order::Order{oid, symbols->intern(symbol), side,
+                                         static_cast<order::qty_t>(qty),
+                                         price}};
+  }
+  // X
+  return CancelOrderAction{tokens.oid()};
+}
+
+void handle_action(Action* action, order::BookMap* books,
+                   order::OrderResult* result, order::ResultSink* sink,
+                   stats::ActionTimer* timer)
+{
+  if (auto* place = std::get_if<PlaceOrderAction>(action)) {
+    books->handle_order(&place->order, result);
+    timer->lap(stats::Phase::kMatch);
+    result->serialize(books->symbols(), sink);
+    timer->lap(stats::Phase::kFormat);
+    timer->done(stats::ActionType::kPlace);
+  } else if (auto* cancel = std::get_if<CancelOrderAction>(action)) {
+    books->cancel_order(cancel->oid, result);
+    timer->lap(stats::Phase::kMatch);
+    result->serialize(books->symbols(), sink);
+    timer->lap(stats::Phase::kFormat);
+    timer->done(stats::ActionType::kCancel);
+  } else if (const auto* print = std::get_if<PrintAction>(action)) {
+    if (print->key == 0) {
+      books->serialize(sink);
+    } else if (print->symbol != order::kInvalidSymbol) {
+      books->serialize(print->symbol, sink, print->depth);
+    }
+    timer->lap(stats::Phase::kFormat);
+    timer->done(stats::ActionType::kPrint);
+  }
+}
+
+void publish_levels(const Action& action, const order::OrderResult& result,
+                    const order::BookMap& books, order::ResultSink* feed)
+{
+  auto send = [&](order::symbol_id_t symbol, order::OrderSide side,
+                  order::price_t price) {
+    feed->level(books.level(symbol, side, price),
+                books.symbols().name(symbol));
+  };
+  if (const auto* place = std::get_if<PlaceOrderAction>(&action)) {
+    if (result.type != order::ResultType::kFilled) {
+      return;
+    }
+    const auto& order = place->order;
+    // Fills go a level at a time.
+    auto resting_side = (order.side == order::OrderSide::kBuy)
+                            ? order::OrderSide::kSell
+                            : order::OrderSide::kBuy;
+    order::price_t last = 0;
+    for (const auto& e : result.fills) {
+      if (e.price != last) {
+        last = e.price;
+        send(e.symbol, resting_side, e.price);
+      }
+    }
+    if (order.qty > 0) {
+      send(order.symbol, order.side, order.price);
+    }
+  } else if (std::holds_alternative<CancelOrderAction>(action)) {
+    if (result.type == order::ResultType::kCancelled) {
+      const auto& cancelled = result.order;
+      send(cancelled.symbol, cancelled.side, cancelled.price);
+    }
+  }
+}
+
+SimpleCross::SimpleCross() { result_.fills.reserve(order::kReservedFills); }
+
+void SimpleCross::action(std::string_view line, order::ResultSink* sink)
+{
+  stats::ActionTimer timer;
+  err_.clear();
+  auto action = deserialize_action(line, &err_, &books_.symbols());
+  timer.lap(stats::Phase::kParse);
+  if (err_.size()) {
+    for (const auto& err : err_) {
+      sink->line(err);
     }
-    return std::make_unique<PlaceOrderAction>(
-        oid, symbol,
-        order::Order{oid, symbol, side, static_cast<order::qty_t>(qty), price});
+    timer.lap(stats::Phase::kFormat);
+    timer.done(stats::ActionType::kError);
+    return;
+  }
+  if (journal_ != nullptr) {
+    journal_->append(action, books_.symbols());
+  }
+  handle_action(&action, &books_, &result_, sink, &timer);
+  if (feed_ != nullptr) {
+    publish_levels(action, result_, books_, feed_);
+  }
+}
 
-  } else if (type == "X") {
-    order::oid_t oid;
-    astream >> oid;
-    return std::make_unique<CancelOrderAction>(oid);
+void SimpleCross::actions(const std::vector<std::string_view>& lines,
+                          order::ResultSink* sink)
+{
+  for (auto line : lines) {
+    action(line, sink);
+  }
+  if (journal_ != nullptr) {
+    journal_->commit();
   }
-  return std::make_unique<Action>();
 }
 
-results_t SimpleCross::action(const std::string& line)
+void SimpleCross::message(std::string_view bytes, order::ResultSink* sink)
 {
-  results_t err;
-  auto action = Action::deserialize(line, &err);
-  if (err.size()) {
-    return err;
+  stats::ActionTimer timer;
+  order::ErrorCode error;
+  order::oid_t oid;
+  auto action = wire::decode_action(bytes, &books_.symbols(), &error, &oid);
+  timer.lap(stats::Phase::kParse);
+  if (error != order::ErrorCode::kNone) {
+    sink->error(error, oid);
+    timer.lap(stats::Phase::kFormat);
+    timer.done(stats::ActionType::kError);
+    return;
+  }
+  if (journal_ != nullptr) {
+    journal_->append(action, books_.symbols());
   }
-  return action->handle_action(&books_);
+  handle_action(&action, &books_, &result_, sink, &timer);
+  if (feed_ != nullptr) {
+    publish_levels(action, result_, books_, feed_);
+  }
+}
+
+void SimpleCross::messages(const std::vector<std::string_view>& messages,
+                           order::ResultSink* sink)
+{
+  for (auto bytes : messages) {
+    message(bytes, sink);
+  }
+  if (journal_ != nullptr) {
+    journal_->commit();
+  }
+}
+
+/**
+ * Straight to the books, no sink and no timing: recovery only needs the
+ * state, the results went out the first time around. Each journal batch
+ * goes through BookMap::handle_batch in one go.
+*/
+bool SimpleCross::recover(const std::string& path, size_t* records,
+                          std::string* err)
+{
+  std::vector<order::BookRequest> requests;
+  order::BatchResult results;
+  auto apply = [&](const ingest::line_batch_t& batch) {
+    requests.clear();
+    for (auto bytes : batch) {
+      order::ErrorCode error;
+      order::oid_t oid;
+      auto action = wire::decode_action(bytes, &books_.symbols(), &error, &oid);
+      if (const auto* place = std::get_if<PlaceOrderAction>(&action)) {
+        requests.push_back(order::BookRequest{place->order, false});
+      } else if (const auto* cancel = std::get_if<CancelOrderAction>(&action)) {
+        order::BookRequest request;
+        request.order.oid = cancel->oid;
+        request.cancel = true;
+        requests.push_back(request);
+      }
+    }
+    books_.handle_batch(requests, &results);
+  };
+  return journal::replay(path, apply, journaled_, records, err);
+}
+
+void SimpleCross::save(std::string* out) const
+{
+  books_.save(out, journal_ != nullptr ? journal_->records() : journaled_);
 }
@@ -1,43 +1,151 @@
 #ifndef SIMPLE_CROSS_H_
 #define SIMPLE_CROSS_H_
 
+#include <cstdint>
 #include <list>
-#include <functional>
-#include <memory>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
 #include <order_book.h>
 #include <order.h>
+#include <result_sink.h>
+#include <stats.h>
+#include <symbol_map.h>
+#include <symbol_table.h>
 
 using results_t = std::list<std::string>;
 
+/**
+ * Actions are plain values decoded in place by deserialize_action,
+ * nothing is allocated per line unless it has to report an error.
+*/
+struct NopAction {
+};
+
+struct PlaceOrderAction {
+  order::Order order;
+};
+
+struct CancelOrderAction {
+  order::oid_t oid;
+};
+
+/**
+ * P prints every book, P SYMBOL only that one, and P SYMBOL N only its
+ * best N levels a side.
+ * A print isn't journaled, so it only looks its symbol up instead of
+ * interning it: ids stay the ones the journaled orders hand out.
+*/
+struct PrintAction {
+  // The symbol, see order::pack_symbol, 0 for every book
+  order::symbol_key_t key = 0;
+  // kInvalidSymbol if nothing was ever ordered on key, no book to print
+  order::symbol_id_t symbol = order::kInvalidSymbol;
+  // Levels per side, 0 for all of them
+  uint16_t depth = 0;
+};
+
+using Action =
+    std::variant<NopAction, PlaceOrderAction, CancelOrderAction, PrintAction>;
+
+/* ACTION: single character value with the following definitions
+    O - place order, requires OID, SYMBOL, SIDE, QTY, PX
+    X - cancel order, requires OID
+    P - print sorted book (see example below), optionally SYMBOL and N
+  OID: positive 32-bit integer value which must be unique for all orders
+  SYMBOL: alpha-numeric string value. Maximum length of 8.
+  SIDE: single character value with the following definitions (B - buy, S -
+  sell) QTY: positive 16-bit integer value PX: positive double precision value
+  (7.5 format)
+  Symbols of valid orders are interned into symbols.*/
+Action deserialize_action(std::string_view action_string, results_t* err,
+                          order::SymbolTable* symbols);
+
+/**
+ * Applies a parsed action to books and writes its results to sink.
+ * PlaceOrderAction's order is handed to the book as is, so it comes back
+ * with its remaining qty and FIFO handle. result is scratch space that is
+ * reused from one action to the next.
+ * timer gets the match and format phases and is done() once the results
+ * are written.
+*/
+void handle_action(Action* action, order::BookMap* books,
+                   order::OrderResult* result, order::ResultSink* sink,
+                   stats::ActionTimer* timer);
+
+/**
+ * Incremental L2 feed: after handle_action, sends feed the aggregate of
+ * every level the action changed, see BookMap::level. Swept levels go
+ * first, best price first, then the level the order rested at, or the
+ * one a cancel took it from. Levels that are gone report 0 qty.
+ * Prints and rejected actions change nothing and send nothing.
+*/
+void publish_levels(const Action& action, const order::OrderResult& result,
+                    const order::BookMap& books, order::ResultSink* feed);
+
+namespace journal
+{
+class Journal;
+}
+
 class SimpleCross
 {
  public:
-  results_t action(const std::string& line);
+  SimpleCross();
 
- private:
-  // Consider hashing on symbol and process per symbol group...
-  order::BookMap books_;
-};
+  void action(std::string_view line, order::ResultSink* sink);
+  /**
+   * Runs a batch of lines in order.
+  */
+  void actions(const std::vector<std::string_view>& lines,
+               order::ResultSink* sink);
+  /**
+   * Same as above for wire::Message encoded actions.
+  */
+  void message(std::string_view bytes, order::ResultSink* sink);
+  void messages(const std::vector<std::string_view>& messages,
+                order::ResultSink* sink);
 
-struct Action {
-  /* ACTION: single character value with the following definitions
-      O - place order, requires OID, SYMBOL, SIDE, QTY, PX
-      X - cancel order, requires OID
-      P - print sorted book (see example below)
-    OID: positive 32-bit integer value which must be unique for all orders
-    SYMBOL: alpha-numeric string value. Maximum length of 8.
-    SIDE: single character value with the following definitions (B - buy, S -
-    sell) QTY: positive 16-bit integer value PX: positive double precision value
-    (7.5 format)*/
-  static std::unique_ptr<Action> deserialize(const std::string& action_string,
-                                             results_t* err);
-  Action() = default;
-  virtual ~Action() = default;
-  virtual results_t handle_action(order::BookMap* books)
+  /**
+   * Journals every parsed order and cancel from now on, actions() and
+   * messages() commit once per batch, callers of action() and message()
+   * commit themselves. journal must outlive this. For results not to get
+   * out ahead of the journal, the sink's output must commit it first, see
+   * OutputBuffer::set_write_barrier.
+  */
+  void set_journal(journal::Journal* journal) { journal_ = journal; }
+  /**
+   * Rebuilds the books from the journal at path without writing any
+   * results, see journal::replay. After a load, the journal messages the
+   * snapshot already covers are skipped, and a journal shorter than that
+   * isn't the one the snapshot was taken with and fails.
+  */
+  bool recover(const std::string& path, size_t* records, std::string* err);
+  /**
+   * Sends the L2 deltas of every action to feed from now on, see
+   * publish_levels. feed must outlive this, nullptr turns it off.
+  */
+  void set_depth_feed(order::ResultSink* feed) { feed_ = feed; }
+  /**
+   * See BookMap::save and BookMap::load. The snapshot records how many
+   * journal messages the books cover: all of the journal's with one
+   * attached, otherwise as many as the snapshot loaded covered.
+  */
+  void save(std::string* out) const;
+  bool load(std::string_view in, std::string* err)
   {
-    (void)books;
-    return {};
+    return books_.load(in, err, &journaled_);
   }
+
+ private:
+  order::OrderResult result_;
+  results_t err_;
+  // Consider hashing on symbol and process per symbol group...
+  order::BookMap books_;
+  journal::Journal* journal_ = nullptr;
+  uint64_t journaled_ = 0;
+  order::ResultSink* feed_ = nullptr;
 };
 
 #endif  // SIMPLE_CROSS_H_
@@ -1,9 +1,82 @@
 #!/bin/sh
-./build/simple_cross < actions.txt
-./build/simple_cross < test/garbage_actions.txt
-./build/test_kill_to_empty
-./build/test_partial_fill
-./build/test_full_fills_asc_desc
-./build/test_full_fills_asc_asc
-./build/test_find_oid_after_many_pushes
-python3 ./test/gen_actions.py 8 100000 | ./build/simple_cross
+set -e
+BUILD_DIR="${1:-./build}"
+"$BUILD_DIR"/simple_cross < actions.txt
+"$BUILD_DIR"/simple_cross --read actions.txt
+"$BUILD_DIR"/sc_convert encode actions.txt > "$BUILD_DIR"/actions.bin
+"$BUILD_DIR"/simple_cross actions.txt > "$BUILD_DIR"/actions.out
+"$BUILD_DIR"/simple_cross --format binary "$BUILD_DIR"/actions.bin |
+  "$BUILD_DIR"/sc_convert decode | cmp - "$BUILD_DIR"/actions.out
+"$BUILD_DIR"/simple_cross --shards 2 actions.txt | cmp - "$BUILD_DIR"/actions.out
+rm -f "$BUILD_DIR"/actions.journal
+"$BUILD_DIR"/simple_cross --journal "$BUILD_DIR"/actions.journal actions.txt |
+  cmp - "$BUILD_DIR"/actions.out
+"$BUILD_DIR"/simple_cross --format binary "$BUILD_DIR"/actions.journal > /dev/null
+echo P | "$BUILD_DIR"/simple_cross --journal "$BUILD_DIR"/actions.journal \
+  > "$BUILD_DIR"/actions.book
+"$BUILD_DIR"/simple_cross --save-snapshot "$BUILD_DIR"/actions.snap actions.txt \
+  > /dev/null
+echo P | "$BUILD_DIR"/simple_cross --load-snapshot "$BUILD_DIR"/actions.snap |
+  cmp - "$BUILD_DIR"/actions.book
+status=0
+echo P | "$BUILD_DIR"/simple_cross --load-snapshot "$BUILD_DIR" \
+  > /dev/null 2>&1 || status=$?
+test "$status" -eq 1
+rm -f "$BUILD_DIR"/split.journal
+head -n 5 actions.txt | "$BUILD_DIR"/simple_cross \
+  --journal "$BUILD_DIR"/split.journal --save-snapshot "$BUILD_DIR"/split.snap \
+  > /dev/null
+tail -n +6 actions.txt | "$BUILD_DIR"/simple_cross \
+  --journal "$BUILD_DIR"/split.journal > /dev/null
+echo P | "$BUILD_DIR"/simple_cross --journal "$BUILD_DIR"/split.journal \
+  --load-snapshot "$BUILD_DIR"/split.snap | cmp - "$BUILD_DIR"/actions.book
+# A journal that can't be written stops the sharded engine cleanly too.
+awk 'BEGIN { for (i = 1; i <= 200000; ++i)
+               printf "O %d IBM %s 10 100.0\n", i, (i % 2) ? "B" : "S" }' \
+  > "$BUILD_DIR"/crossing.txt
+rm -f "$BUILD_DIR"/full.journal
+status=0
+(trap '' XFSZ; ulimit -f 64
+ exec "$BUILD_DIR"/simple_cross --shards 2 --journal "$BUILD_DIR"/full.journal \
+   "$BUILD_DIR"/crossing.txt > /dev/null 2>&1) || status=$?
+test "$status" -eq 1
+# Fills show up while the writer of the input is still going.
+for shards in "" "--shards 2"; do
+  rm -f "$BUILD_DIR"/live.out
+  (printf 'O 1 IBM B 10 100.0\nO 2 IBM S 10 100.0\n'; sleep 2; echo P) |
+    "$BUILD_DIR"/simple_cross $shards > "$BUILD_DIR"/live.out &
+  sleep 1
+  grep -q '^F 1 IBM 10' "$BUILD_DIR"/live.out
+  wait
+done
+"$BUILD_DIR"/simple_cross < test/garbage_actions.txt
+status=0
+"$BUILD_DIR"/simple_cross --read "$BUILD_DIR" 2> /dev/null || status=$?
+test "$status" -eq 1
+"$BUILD_DIR"/test_kill_to_empty
+"$BUILD_DIR"/test_partial_fill
+"$BUILD_DIR"/test_full_fills_asc_desc
+"$BUILD_DIR"/test_full_fills_asc_asc
+"$BUILD_DIR"/test_find_oid_after_many_pushes
+"$BUILD_DIR"/test_level_map_window
+"$BUILD_DIR"/test_spread
+"$BUILD_DIR"/test_oid_index
+"$BUILD_DIR"/test_symbol_table
+"$BUILD_DIR"/test_parser
+"$BUILD_DIR"/test_ingest
+"$BUILD_DIR"/test_result_sink
+"$BUILD_DIR"/test_wire
+"$BUILD_DIR"/test_sharded_cross
+"$BUILD_DIR"/test_arena
+"$BUILD_DIR"/test_stats
+"$BUILD_DIR"/test_journal
+"$BUILD_DIR"/test_snapshot
+"$BUILD_DIR"/test_depth_feed
+"$BUILD_DIR"/test_print_depth
+"$BUILD_DIR"/test_sweep_allocations
+"$BUILD_DIR"/test_book_batch
+"$BUILD_DIR"/test_tombstone_compaction
+"$BUILD_DIR"/test_symbol_map
+"$BUILD_DIR"/test_book_retention
+"$BUILD_DIR"/bench/sc_bench --orders 1000 > /dev/null
+python3 ./test/gen_actions.py 8 100000 | "$BUILD_DIR"/simple_cross
@@ -0,0 +1,88 @@
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <arena.h>
+#include <order_book.h>
+#include <order.h>
+#include <level_map.h>
+#include "test_utils.h"
+
+/**
+ * test_arena:
+ * 1. Checks that memory given back to an Arena is handed out again for
+ *    the same size instead of coming from a new block.
+ * 2. Books and drains orders on a LevelMap over an Arena while the price
+ *    oscillates, the way the touch moves when the spread does, and checks
+ *    that after the first round the Arena doesn't take any more memory
+ *    from the heap: emptied levels, FIFO nodes, and spill map nodes are
+ *    all recycled.
+ * 3. Pushes enough orders onto one level to span several NodePool chunks
+ *    and checks every handle still finds its order.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  {
+    levelmap::Arena arena;
+    void *first = arena.allocate(40);
+    arena.deallocate(first, 40);
+    assertm(arena.allocate(48) == first, "Expected 16 byte size classes");
+    auto reserved = arena.reserved();
+    for (size_t i = 0; i < 1000; ++i) {
+      void *p = arena.allocate(100);
+      arena.deallocate(p, 100);
+    }
+    assertm(arena.reserved() == reserved, "Expected the block to be reused");
+  }
+
+  const order::price_t base = 100 * order::kPriceScale;
+  const auto far = static_cast<order::price_t>(levelmap::kWindowLevels) * 4;
+  levelmap::Arena arena;
+  levelmap::ArenaAllocator<order::Order> alloc(&arena);
+  levelmap::MinLevelMap levels(alloc);
+  size_t after_first_round = 0;
+  order::oid_t oid = 0;
+  for (size_t round = 0; round < 50; ++round) {
+    // Both inside the window and spilled.
+    for (order::price_t offset : {order::price_t{0}, order::price_t{1}, far}) {
+      for (order::price_t i = 0; i < 20; ++i) {
+        auto price = base + offset + i;
+        for (size_t n = 0; n < 5; ++n) {
+          levels.push_back_with_key(
+              price, order::Order{oid++, kDefaultSymbol,
+                                  order::OrderSide::kBuy, 10, price});
+        }
+      }
+    }
+    while (!levels.map_empty()) {
+      levels.erase(levels.lowest_price());
+    }
+    if (round == 0) {
+      after_first_round = arena.reserved();
+    }
+  }
+  ostream << "arena bytes: " << arena.reserved() << '\n';
+  assertm(after_first_round > 0, "Expected the levels to use the arena");
+  assertm(arena.reserved() == after_first_round,
+          "Expected levels to be recycled");
+
+  if constexpr (levelmap::MinLevelMap::kIntrusive) {
+    levelmap::MinLevelMap deep{};
+    std::vector<order::fifo_idx_t> handles;
+    for (order::oid_t i = 0; i < 20000; ++i) {
+      handles.push_back(deep.push_back_with_key(
+          base, order::Order{i, kDefaultSymbol, order::OrderSide::kBuy, 1,
+                             base}));
+    }
+    for (order::oid_t i = 0; i < handles.size(); i += 7) {
+      assertm(deep.erase_order(base, handles[i], i),
+              "Expected every handle to find its order");
+    }
+  }
+
+  return 0;
+}
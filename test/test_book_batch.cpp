@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <list>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+#include <order_book.h>
+#include <order.h>
+#include <result_sink.h>
+#include "test_utils.h"
+
+/**
+ * A seeded mix of orders, some crossing, some at a bad price, and cancels,
+ * over a few symbols and few enough OIDs that duplicates and cancels of
+ * orders placed earlier in the same burst are common.
+*/
+static std::vector<order::BookRequest> make_requests(size_t n,
+                                                     order::BookMap *books)
+{
+  std::mt19937 gen(22);
+  auto pick = [&](unsigned bound) {
+    return std::uniform_int_distribution<unsigned>(0, bound - 1)(gen);
+  };
+  // Interned up front, so every BookMap gets the same ids.
+  const char *names[] = {"IBM", "AAPL", "MSFT", "GOOG"};
+  order::symbol_id_t symbols[4];
+  for (size_t i = 0; i < 4; ++i) {
+    symbols[i] = books->symbols().intern(names[i]);
+  }
+  std::vector<order::BookRequest> requests;
+  for (size_t i = 0; i < n; ++i) {
+    order::BookRequest request;
+    request.order.oid = 1 + pick(300);
+    if (pick(10) < 3) {
+      request.cancel = true;
+    } else {
+      request.order.symbol = symbols[pick(4)];
+      request.order.side =
+          pick(2) ? order::OrderSide::kBuy : order::OrderSide::kSell;
+      request.order.qty = static_cast<order::qty_t>(1 + pick(20));
+      request.order.price =
+          (pick(50) == 0) ? 0
+                          : static_cast<order::price_t>(95 + pick(10)) *
+                                order::kPriceScale;
+    }
+    requests.push_back(request);
+  }
+  return requests;
+}
+
+/**
+ * test_book_batch:
+ * 1. Runs the same requests through handle_order/cancel_order one at a
+ *    time on one BookMap, and through handle_batch in bursts of 1, 7, and
+ *    300 on others.
+ * 2. Checks every burst size prints the same results, leaves the same
+ *    books, and reports each placed order as the book left it.
+ * 3. Checks that each entry's fills sit right behind the previous
+ *    entry's in the shared buffer, and that an empty burst is empty.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  constexpr size_t kRequests = 3000;
+  order::BookMap single;
+  auto requests = make_requests(kRequests, &single);
+  std::list<std::string> expected;
+  order::ListSink expected_sink(&expected);
+  std::vector<order::Order> placed;
+  order::OrderResult result;
+  for (const auto &request : requests) {
+    auto order = request.order;
+    if (request.cancel) {
+      single.cancel_order(order.oid, &result);
+    } else {
+      single.handle_order(&order, &result);
+    }
+    result.serialize(single.symbols(), &expected_sink);
+    placed.push_back(order);
+  }
+
+  for (size_t burst : {size_t{1}, size_t{7}, size_t{300}}) {
+    order::BookMap batched;
+    make_requests(0, &batched);
+    std::list<std::string> lines;
+    order::ListSink sink(&lines);
+    order::BatchResult out;
+    size_t fills = 0;
+    for (size_t begin = 0; begin < requests.size(); begin += burst) {
+      auto n = std::min(burst, requests.size() - begin);
+      batched.handle_batch(
+          std::span<const order::BookRequest>(&requests[begin], n), &out);
+      assertm(out.entries.size() == n, "Expected one entry per request");
+      uint32_t next_fill = 0;
+      for (size_t i = 0; i < n; ++i) {
+        const auto &entry = out.entries[i];
+        out.serialize(i, batched.symbols(), &sink);
+        assertm(entry.first_fill == next_fill,
+                "Expected fills back to back");
+        next_fill += entry.num_fills;
+        if (!requests[begin + i].cancel &&
+            entry.type == order::ResultType::kFilled) {
+          const auto &order = placed[begin + i];
+          assertm(entry.order.qty == order.qty &&
+                      entry.order.idx == order.idx,
+                  "Expected the order as the book left it");
+        }
+      }
+      assertm(next_fill == out.fills.size(), "Expected every fill");
+      fills += out.fills.size();
+    }
+    ostream << "burst " << burst << ": " << lines.size() << " lines, "
+            << fills << " fills\n";
+    assertm(lines == expected, "Expected the same results as one at a time");
+    assertm(batched.serialize() == single.serialize(),
+            "Expected the same books as one at a time");
+  }
+  assertm(expected.size() > kRequests, "Expected fills");
+
+  order::BatchResult out;
+  single.handle_batch({}, &out);
+  assertm(out.entries.empty() && out.fills.empty(),
+          "Expected nothing for an empty burst");
+
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+#include <order_book.h>
+#include <order.h>
+#include "test_utils.h"
+
+static size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+  ++allocations;
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+/**
+ * Rests one order on symbol and cancels it, which drains its book.
+ * Returns how many allocations that took.
+*/
+static size_t flip(order::BookMap *books, order::symbol_id_t symbol,
+                   order::OrderResult *result)
+{
+  auto before = allocations;
+  order::Order buy{7, symbol, order::OrderSide::kBuy, 10,
+                   100 * order::kPriceScale};
+  books->handle_order(&buy, result);
+  books->cancel_order(buy.oid, result);
+  return allocations - before;
+}
+
+/**
+ * test_book_retention:
+ * 1. Drains a book over and over and checks it is kept: once warm,
+ *    filling and draining it again doesn't allocate.
+ * 2. Checks that with retention off every drain frees the book.
+ * 3. Drains three books with room for two idle ones and checks the one
+ *    that was idle longest is the one freed, and that a book that comes
+ *    back to life stops counting as idle.
+ * 4. Checks a purge frees every idle book, and that idle books print
+ *    nothing, save nothing, and don't stand in the way of a load.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  order::BookMap books;
+  auto ibm = books.symbols().intern("IBM");
+  auto aapl = books.symbols().intern("AAPL");
+  auto msft = books.symbols().intern("MSFT");
+  order::OrderResult result{};
+  result.fills.reserve(order::kReservedFills);
+  flip(&books, ibm, &result);
+  assertm(books.idle_books() == 1, "Expected the drained book to be kept");
+  // Lets the book's bookkeeping reach its steady size first.
+  for (int i = 0; i < 1000; ++i) {
+    flip(&books, ibm, &result);
+  }
+  size_t warm = 0;
+  for (int i = 0; i < 1000; ++i) {
+    warm += flip(&books, ibm, &result);
+  }
+  ostream << "warm flips: " << warm << " allocations\n";
+  assertm(warm == 0, "Expected a kept book not to allocate");
+  assertm(books.idle_books() == 1, "Expected one idle book");
+
+  books.set_max_idle_books(0);
+  assertm(books.idle_books() == 0, "Expected the idle book to be freed");
+  auto cold = flip(&books, ibm, &result);
+  ostream << "cold flip: " << cold << " allocations\n";
+  assertm(cold > 0, "Expected a fresh book every time");
+
+  books.set_max_idle_books(2);
+  flip(&books, ibm, &result);
+  flip(&books, aapl, &result);
+  flip(&books, msft, &result);
+  assertm(books.idle_books() == 2, "Expected two idle books");
+  assertm(flip(&books, msft, &result) == 0, "Expected MSFT's book kept");
+  assertm(flip(&books, aapl, &result) == 0, "Expected AAPL's book kept");
+  assertm(flip(&books, ibm, &result) > 0, "Expected IBM's book freed");
+
+  order::Order rest{8, aapl, order::OrderSide::kSell, 5,
+                    101 * order::kPriceScale};
+  books.handle_order(&rest, &result);
+  assertm(books.idle_books() == 1, "Expected AAPL's book back in use");
+  auto printed = books.serialize();
+  assertm(printed.size() == 1, "Expected idle books to print nothing");
+  std::string saved;
+  books.save(&saved);
+
+  books.purge_idle_books();
+  assertm(books.idle_books() == 0, "Expected nothing idle after a purge");
+  assertm(books.serialize() == printed, "Expected the same book");
+
+  order::BookMap copy;
+  copy.symbols().intern("IBM");
+  auto copy_aapl = copy.symbols().intern("AAPL");
+  flip(&copy, copy_aapl, &result);
+  assertm(copy.idle_books() == 1, "Expected an idle book to load over");
+  std::string err;
+  assertm(copy.load(saved, &err), "Expected the snapshot to load");
+  assertm(copy.idle_books() == 0, "Expected the idle book to be dropped");
+  assertm(copy.serialize() == printed, "Expected the same book");
+  copy.cancel_order(rest.oid, &result);
+  assertm(copy.idle_books() == 1, "Expected the loaded book to idle");
+
+  return 0;
+}
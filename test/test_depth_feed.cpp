@@ -0,0 +1,168 @@
+#include <cstddef>
+#include <fstream>
+#include <list>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include <order_book.h>
+#include <order.h>
+#include <result_sink.h>
+#include <simple_cross.h>
+#include "test_utils.h"
+
+/**
+ * Keeps the L2 book a feed subscriber would: the last aggregate seen per
+ * level, levels at 0 qty dropped.
+*/
+class DepthReplica : public order::ResultSink
+{
+ public:
+  using key_t = std::tuple<std::string, order::OrderSide, order::price_t>;
+  using value_t = std::pair<uint64_t, uint32_t>;
+
+  void line(std::string_view) override { ++unexpected; }
+  void fill(const order::Order &, std::string_view) override { ++unexpected; }
+  void cancel(order::oid_t) override { ++unexpected; }
+  void error(order::ErrorCode, order::oid_t) override { ++unexpected; }
+  void book_order(const order::Order &, std::string_view) override
+  {
+    ++unexpected;
+  }
+  void level(const order::LevelDepth &depth, std::string_view symbol) override
+  {
+    key_t key{std::string(symbol), depth.side, depth.price};
+    if (depth.qty == 0) {
+      levels.erase(key);
+    } else {
+      levels[key] = {depth.qty, depth.orders};
+    }
+    ++updates;
+  }
+
+  std::map<key_t, value_t> levels;
+  size_t updates = 0;
+  size_t unexpected = 0;
+};
+
+static std::list<std::string> run(SimpleCross *scross,
+                                  const std::vector<std::string_view> &lines)
+{
+  std::list<std::string> out;
+  order::ListSink sink(&out);
+  scross->actions(lines, &sink);
+  return out;
+}
+
+/**
+ * test_depth_feed:
+ * 1. Rests a few orders, sweeps two levels into a third, and cancels one,
+ *    checking the exact L lines each action sends to the feed, and that
+ *    prints and rejected actions send none.
+ * 2. Checks BookMap::depth on the same book: top 1 and everything.
+ * 3. Runs a seeded mix of orders and cancels, keeping an L2 replica off of
+ *    the feed alone, and checks it against a full depth snapshot of the
+ *    book after every batch.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  SimpleCross scross;
+  std::list<std::string> feed;
+  order::ListSink feed_sink(&feed);
+  scross.set_depth_feed(&feed_sink);
+  run(&scross, {"O 1 IBM S 10 100.00000", "O 2 IBM S 5 100.00000",
+                "O 3 IBM S 7 101.00000", "O 4 IBM B 4 98.00000"});
+  std::list<std::string> expected = {
+      "L IBM S 10 1 100.00000", "L IBM S 15 2 100.00000",
+      "L IBM S 7 1 101.00000", "L IBM B 4 1 98.00000"};
+  assertm(feed == expected, "Expected one L line per resting order");
+
+  feed.clear();
+  run(&scross, {"O 5 IBM B 20 101.00000", "P", "O 3 IBM B 1 1.00000",
+                "X 99", "Z"});
+  expected = {"L IBM S 0 0 100.00000", "L IBM S 2 1 101.00000"};
+  for (const auto &line : feed) {
+    ostream << line << '\n';
+  }
+  assertm(feed == expected, "Expected the swept levels only");
+
+  feed.clear();
+  run(&scross, {"O 6 IBM B 3 98.00000", "X 4"});
+  expected = {"L IBM B 7 2 98.00000", "L IBM B 3 1 98.00000"};
+  assertm(feed == expected, "Expected the cancel's level");
+
+  std::list<std::string> depth;
+  order::ListSink depth_sink(&depth);
+  order::BookMap books;
+  auto ibm = books.symbols().intern("IBM");
+  std::vector<std::string_view> book = {
+      "O 1 IBM S 10 100.00000", "O 2 IBM S 5 101.00000",
+      "O 3 IBM B 7 99.00000",   "O 4 IBM B 1 99.00000",
+      "O 5 IBM B 2 98.00000"};
+  order::OrderResult result;
+  std::list<std::string> errors;
+  for (auto line : book) {
+    auto action = deserialize_action(line, &errors, &books.symbols());
+    books.handle_order(&std::get<PlaceOrderAction>(action).order, &result);
+  }
+  books.depth(ibm, 1, &depth_sink);
+  expected = {"L IBM B 8 2 99.00000", "L IBM S 10 1 100.00000"};
+  assertm(depth == expected, "Expected the top level of each side");
+  depth.clear();
+  books.depth(ibm, 10, &depth_sink);
+  assertm(depth.size() == 4, "Expected every level");
+  assertm(depth.back() == "L IBM S 5 1 101.00000", "Expected asks last");
+  depth.clear();
+  books.depth(ibm + 1, 10, &depth_sink);
+  assertm(depth.empty(), "Expected nothing without a book");
+
+  SimpleCross random;
+  DepthReplica replica;
+  random.set_depth_feed(&replica);
+  std::mt19937 gen(18);
+  auto pick = [&](unsigned bound) {
+    return std::uniform_int_distribution<unsigned>(0, bound - 1)(gen);
+  };
+  const char *symbols[] = {"IBM", "AAPL", "MSFT"};
+  for (size_t b = 0; b < 200; ++b) {
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < 50; ++i) {
+      auto oid = std::to_string(1 + pick(400));
+      if (pick(10) < 7) {
+        lines.push_back("O " + oid + " " + symbols[pick(3)] + " " +
+                        (pick(2) ? "B " : "S ") +
+                        std::to_string(1 + pick(30)) + " " +
+                        std::to_string(95 + pick(10)) + ".0");
+      } else {
+        lines.push_back("X " + oid);
+      }
+    }
+    run(&random, std::vector<std::string_view>(lines.begin(), lines.end()));
+
+    // The replica only ever hears about levels through the feed, the
+    // snapshot comes from a copy of the books.
+    DepthReplica snapshot;
+    std::string saved;
+    random.save(&saved);
+    order::BookMap copy;
+    std::string err;
+    assertm(copy.load(saved, &err), "Expected the books to reload");
+    for (order::symbol_id_t id = 0; id < copy.symbols().size(); ++id) {
+      copy.depth(id, order::kMaxQuantity, &snapshot);
+    }
+    assertm(snapshot.levels == replica.levels,
+            "Expected the feed to rebuild the book's levels");
+  }
+  assertm(replica.unexpected == 0, "Expected nothing but L records");
+  ostream << "updates: " << replica.updates
+          << " levels: " << replica.levels.size() << '\n';
+  assertm(replica.updates > 1000, "Expected a busy feed");
+
+  return 0;
+}
@@ -6,28 +6,58 @@
 #include "test_utils.h"
 
 // fill a FIFO until it has to realloc then make sure we can find the right order again.
+// Then pop orders off the front with a fill and make sure the handles of the
+// orders behind them still find the right order.
 int main(int argc, char* argv[])
 {
   (void)argc;
   std::string ofile = std::string(argv[0]) + ".log";
   std::ofstream ostream(ofile, std::ios::out);
-  return 0;
 
   constexpr size_t num_order_objects = 0x10000;
-  auto orders = generate_dummy_n_orders(num_order_objects, 0);
+  constexpr order::qty_t order_quantity = 10;
+  auto orders = generate_dummy_n_orders(num_order_objects, 0, order_quantity);
 
   order::OrderBook test_book{};
   std::vector<order::OrderResult> results{};
   results.resize(orders.size());
   test_book.place_orders(&orders, &results);
 
-  test_book.kill_order(
-      results.back().orders.back());  // 0 out the last order in the deque
+  // Kill the youngest order in the FIFO.
+  assertm(test_book.kill_order(orders.back()), "Expected to find the order");
+  assertm(!test_book.kill_order(orders.back()), "Expected it to be gone");
+  assertm(test_book.buy_order_count() ==
+              order_quantity * (num_order_objects - 1),
+          "Expected one order's worth of quantity less");
+
+  // Fill the 3 oldest orders, which pops them off the front of the FIFO.
+  order::Order sell{static_cast<order::oid_t>(num_order_objects),
+                    kDefaultSymbol, order::OrderSide::kSell,
+                    3 * order_quantity, orders.front().price};
+  order::OrderResult result{};
+  test_book.place_order(&sell, &result);
+  assertm(result.fills.size() == 3, "Expected 3 fills");
+  assertm(!test_book.kill_order(orders.front()),
+          "Expected the filled order to be gone");
 
-  auto& buy_orders = test_book.get_buy_orders();
-  const auto& level = buy_orders.get_level(100.0);
+  // Orders behind the popped ones are still found through their handles.
+  auto& middle = orders[num_order_objects / 2];
+  assertm(test_book.kill_order(middle), "Expected to find the middle order");
+  auto& behind = orders[5];
+  assertm(test_book.kill_order(behind), "Expected to find an older order");
 
-  assertm(level.fifo.back().qty == 0, "Expected last order qty to be 0");
+  const auto& buy_orders = test_book.get_buy_orders();
+  const auto& level = buy_orders.get_level(orders.front().price);
+  assertm(level.fifo.front().oid == orders[3].oid,
+          "Expected the oldest live order at the front");
+  if constexpr (levelmap::MinLevelMap::kIntrusive) {
+    // std::deque FIFOs still hold the killed youngest order as a tombstone
+    assertm(level.fifo.back().oid == orders[num_order_objects - 2].oid,
+            "Expected the youngest live order at the back");
+  }
+  assertm(test_book.buy_order_count() ==
+              order_quantity * (num_order_objects - 6),
+          "Expected the killed and filled orders to be gone");
 
   return 0;
 }
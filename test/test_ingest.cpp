@@ -0,0 +1,77 @@
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <ingest.h>
+#include "test_utils.h"
+
+static std::vector<std::string> read_all(ingest::LineSource *source)
+{
+  std::vector<std::string> lines;
+  ingest::line_batch_t batch;
+  while (source->next_batch(&batch)) {
+    assertm(batch.size() <= ingest::kBatchLines, "Expected bounded batches");
+    lines.insert(lines.end(), batch.begin(), batch.end());
+  }
+  return lines;
+}
+
+/**
+ * test_ingest:
+ * Writes a file with lines that straddle kBlockSize, one line longer than
+ * kBlockSize, empty lines, and no trailing '\n', then checks that both
+ * the mapped and the block read sources split it like std::getline.
+ * Checks that a source that fails to read says so instead of just ending.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  std::string contents;
+  for (size_t i = 0; contents.size() < 3 * ingest::kBlockSize; ++i) {
+    contents += "O " + std::to_string(i) + " IBM B 10 100.0\n";
+    if (i % 1000 == 0) {
+      contents += "\n";
+    }
+  }
+  contents += std::string(ingest::kBlockSize + 3, 'P') + "\n";
+  contents += "X 7";
+  std::string path = std::string(argv[0]) + ".actions";
+  std::ofstream(path, std::ios::out | std::ios::binary) << contents;
+
+  std::vector<std::string> expected;
+  std::istringstream stream(contents);
+  for (std::string line; std::getline(stream, line);) {
+    expected.push_back(line);
+  }
+
+  for (auto mode : {ingest::Mode::kMmap, ingest::Mode::kRead}) {
+    std::string err;
+    auto source = ingest::open_source(path, mode, &err);
+    assertm(source != nullptr, "Expected to open the file");
+    assertm(read_all(source.get()) == expected,
+            "Expected the same lines as std::getline");
+  }
+
+  std::string err;
+  assertm(ingest::open_source(path + ".missing", ingest::Mode::kMmap, &err) ==
+              nullptr,
+          "Expected a missing file to fail");
+  assertm(!err.empty(), "Expected an error message");
+
+  // A directory opens but can't be read(2), which isn't the end of it.
+  auto source = ingest::open_source(".", ingest::Mode::kMmap, &err);
+  assertm(source != nullptr, "Expected to open the directory");
+  assertm(read_all(source.get()).empty(), "Expected no lines");
+  assertm(!source->error().empty(), "Expected the read error");
+  for (auto mode : {ingest::Mode::kMmap, ingest::Mode::kRead}) {
+    source = ingest::open_source(path, mode, &err);
+    read_all(source.get());
+    assertm(source->error().empty(), "Expected no error at the end");
+  }
+
+  return 0;
+}
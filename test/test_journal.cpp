@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <csignal>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <result_sink.h>
+#include <journal.h>
+#include <simple_cross.h>
+#include <wire.h>
+#include "test_utils.h"
+
+static size_t file_size(const std::string &path)
+{
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  return static_cast<size_t>(in.tellg());
+}
+
+static std::string run(SimpleCross *scross,
+                       const std::vector<std::string_view> &lines)
+{
+  order::OutputBuffer out;
+  order::BufferSink sink(&out);
+  scross->actions(lines, &sink);
+  return std::string(out.view());
+}
+
+/**
+ * test_journal:
+ * 1. Runs a first batch of actions with a journal, checks that only its
+ *    orders and cancels were journaled, and that the file holds them once
+ *    the batch is done.
+ * 2. Tears the last message in half, recovers a fresh SimpleCross from the
+ *    journal and checks that the torn message is skipped, and that the
+ *    second batch and a P come out exactly as they do on the original,
+ *    books in the same order even though a P MSFT came before any order
+ *    on MSFT.
+ * 3. Reopening the journal cuts the torn message off.
+ * 4. Snapshots a journaled engine between the two batches, and checks
+ *    that loading the snapshot and recovering from the journal replays
+ *    only the second batch into the same books, and that a journal
+ *    shorter than the snapshot says is refused.
+ * 5. Runs one batch with more results than an OutputBuffer holds through
+ *    an output whose write barrier commits the journal, and checks every
+ *    write happens mid-batch with the actions behind it already on disk.
+ *    A barrier that throws keeps the results from going out at all.
+ * 6. Caps the file size mid-message so a commit writes part of a batch and
+ *    fails, then lifts the cap and commits again, and checks the journal
+ *    holds every message once and replays into the same books.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+  std::string path = std::string(argv[0]) + ".journal";
+  std::remove(path.c_str());
+
+  const std::vector<std::string_view> first = {
+      "O 1 IBM B 10 100.00000", "O 2 IBM S 5 100.00000",
+      "P MSFT",                 "O 3 AAPL S 7 42.00000",
+      "O 1 IBM B 3 99.00000",
+      "X 9",                    "P",
+      "O 4 IBM B 0x 1.0",       "O 5 MSFT S 9 10.00000",
+  };
+  const std::vector<std::string_view> second = {
+      "O 6 IBM S 5 99.00000", "X 3", "O 7 AAPL B 1 50.00000", "P",
+  };
+  std::string err;
+  SimpleCross original;
+  {
+    auto journal = journal::Journal::open(path, journal::Sync::kBatch,
+                                          std::chrono::milliseconds(0), &err);
+    assertm(journal != nullptr, "Expected to open the journal");
+    original.set_journal(journal.get());
+    run(&original, first);
+    // 5 orders (the duplicate OID included) and the cancel.
+    assertm(journal->records() == 6, "Expected only O and X journaled");
+    original.set_journal(nullptr);
+  }
+  assertm(file_size(path) == 6 * wire::kMessageSize,
+          "Expected the batch on disk");
+
+  {
+    std::ofstream torn(path, std::ios::binary | std::ios::app);
+    torn << std::string(wire::kMessageSize / 2, 'O');
+  }
+  SimpleCross recovered;
+  size_t records = 0;
+  assertm(recovered.recover(path, &records, &err), "Expected to recover");
+  assertm(records == 6, "Expected the torn message to be skipped");
+  auto expected = run(&original, second);
+  auto actual = run(&recovered, second);
+  ostream << actual;
+  assertm(expected.find("\nP ") != std::string::npos, "Expected a book");
+  assertm(actual == expected, "Expected the same books after recovery");
+
+  {
+    auto journal = journal::Journal::open(path, journal::Sync::kNone,
+                                          std::chrono::milliseconds(0), &err);
+    assertm(journal != nullptr, "Expected to reopen the journal");
+  }
+  assertm(file_size(path) == 6 * wire::kMessageSize,
+          "Expected the torn message to be cut off");
+
+  SimpleCross empty;
+  assertm(empty.recover(path + ".missing", &records, &err) && records == 0,
+          "Expected a missing journal to be empty");
+
+  std::string split = path + ".split";
+  std::remove(split.c_str());
+  SimpleCross journaled;
+  std::string snapshot;
+  {
+    auto journal = journal::Journal::open(split, journal::Sync::kNone,
+                                          std::chrono::milliseconds(0), &err);
+    assertm(journal != nullptr, "Expected to open the journal");
+    journaled.set_journal(journal.get());
+    run(&journaled, first);
+    journaled.save(&snapshot);
+    run(&journaled, second);
+    journaled.set_journal(nullptr);
+  }
+  SimpleCross resumed;
+  assertm(resumed.load(snapshot, &err), "Expected the snapshot to load");
+  assertm(resumed.recover(split, &records, &err), "Expected to recover");
+  assertm(records == 3, "Expected only the second batch replayed");
+  const std::vector<std::string_view> print = {"P"};
+  assertm(run(&resumed, print) == run(&journaled, print),
+          "Expected the same books from the snapshot and the journal");
+  SimpleCross early;
+  assertm(early.load(snapshot, &err), "Expected the snapshot to load");
+  assertm(!early.recover(path + ".missing", &records, &err),
+          "Expected a journal older than the snapshot to be refused");
+
+  std::string ahead = path + ".ahead";
+  std::string results = path + ".results";
+  std::remove(ahead.c_str());
+  int fd = ::open(results.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  assertm(fd >= 0, "Expected to open the results");
+  // One resting order, then nothing but duplicates: a line for each.
+  const std::string_view duplicate_line = "E 1 Duplicate order id\n";
+  const std::vector<std::string_view> duplicates(
+      2 * order::kFlushSize / duplicate_line.size(), "O 1 IBM B 1 10.00000");
+  size_t writes = 0;
+  {
+    auto journal = journal::Journal::open(ahead, journal::Sync::kNone,
+                                          std::chrono::milliseconds(0), &err);
+    assertm(journal != nullptr, "Expected to open the journal");
+    SimpleCross engine;
+    engine.set_journal(journal.get());
+    order::OutputBuffer out(fd);
+    out.set_write_barrier([&] {
+      journal->commit();
+      auto lines = file_size(results) / duplicate_line.size() +
+                   static_cast<size_t>(std::count(out.view().begin(),
+                                                  out.view().end(), '\n'));
+      assertm(file_size(ahead) / wire::kMessageSize > lines,
+              "Expected the actions on disk before their results");
+      ++writes;
+    });
+    order::BufferSink sink(&out);
+    engine.actions(duplicates, &sink);
+    assertm(writes > 0, "Expected results written mid-batch");
+    out.flush();
+  }
+  ostream << "barrier writes " << writes << '\n';
+  assertm(file_size(results) == duplicate_line.size() * (duplicates.size() - 1),
+          "Expected every duplicate's line");
+  {
+    order::OutputBuffer out(fd);
+    out.set_write_barrier([] { throw std::runtime_error("refused"); });
+    out.append(duplicate_line);
+    bool threw = false;
+    try {
+      out.flush();
+    } catch (const std::runtime_error &) {
+      threw = true;
+    }
+    assertm(threw, "Expected the barrier's exception");
+  }
+  ::close(fd);
+  assertm(file_size(results) == duplicate_line.size() * (duplicates.size() - 1),
+          "Expected nothing written past a refusing barrier");
+
+  std::string capped = path + ".capped";
+  std::remove(capped.c_str());
+  std::vector<std::string> orders;
+  for (int oid = 1; oid <= 20; ++oid) {
+    orders.push_back("O " + std::to_string(oid) + " IBM " +
+                     (oid % 2 ? "B" : "S") + " 1 10.00000");
+  }
+  const std::vector<std::string_view> batch(orders.begin(), orders.end());
+  std::signal(SIGXFSZ, SIG_IGN);
+  rlimit limit{};
+  assertm(::getrlimit(RLIMIT_FSIZE, &limit) == 0, "Expected the file cap");
+  auto uncapped = limit;
+  SimpleCross partial;
+  {
+    auto journal = journal::Journal::open(capped, journal::Sync::kNone,
+                                          std::chrono::milliseconds(0), &err);
+    assertm(journal != nullptr, "Expected to open the journal");
+    partial.set_journal(journal.get());
+    limit.rlim_cur = 7 * wire::kMessageSize + wire::kMessageSize / 2;
+    assertm(::setrlimit(RLIMIT_FSIZE, &limit) == 0, "Expected to cap");
+    bool threw = false;
+    try {
+      run(&partial, batch);
+    } catch (const std::system_error &) {
+      threw = true;
+    }
+    assertm(threw, "Expected the capped commit to fail");
+    assertm(file_size(capped) == limit.rlim_cur, "Expected a partial write");
+    assertm(::setrlimit(RLIMIT_FSIZE, &uncapped) == 0, "Expected to uncap");
+    journal->commit();
+    partial.set_journal(nullptr);
+  }
+  assertm(file_size(capped) == batch.size() * wire::kMessageSize,
+          "Expected every message written once");
+  SimpleCross replayed;
+  assertm(replayed.recover(capped, &records, &err), "Expected to recover");
+  assertm(records == batch.size(), "Expected every message replayed");
+  assertm(run(&replayed, print) == run(&partial, print),
+          "Expected the same books after a retried commit");
+
+  return 0;
+}
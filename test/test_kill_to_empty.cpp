@@ -7,13 +7,15 @@
 /**
  * test_kill_to_empty:
  * 1. Adds kNumOrders or the order book
- * 2. Kills them all
- *    Note: At this point we expect the order_count to be 0,
- *    but because of how I've chosen to design the order cancellation flow
- *    we expect the FIFO containing those orders to still have them, granted at .qty == 0.
- * 4. Cross an order that would otherwise have been filled by the cancelled orders.
- * 5. Verify that the cancelled orders were popped off their fifos.
- * 6. Cross one more order to fill the one placed in Step 4.
+ * 2. Kills all but the youngest one
+ *    Note: At this point we expect the order_count to be that of one order.
+ *    Intrusive FIFOs unlink the cancelled orders right away, std::deque FIFOs
+ *    (DEQUE_FIFO builds) still hold up to kCompactTombstones of them,
+ *    granted at .qty == 0, the rest were compacted away.
+ * 4. Cross an order that fills the survivor behind the cancelled orders.
+ * 5. Verify that no cancelled orders are left in the fifos.
+ * 6. Place and kill one more order, killing the last live order on a level
+ *    drops the level (and any tombstones) right away.
  * 7. Verify that all of our data structures and counts corroborate (0, empty).
 */
 int main(int argc, char* argv[])
@@ -30,33 +32,43 @@ int main(int argc, char* argv[])
   order::OrderBook test_book{};
   // * 1. Add num_orders or the order book
   test_book.place_orders(&dummy_buys, &results);
-  // * 2. Kill them all
-  for (auto& d : dummy_buys) {
-    test_book.kill_order(d);
+  // * 2. Kill all but the youngest
+  for (size_t i = 0; i + 1 < dummy_buys.size(); ++i) {
+    test_book.kill_order(dummy_buys[i]);
   }
-  //  * Verify that the order_count to be 0,
-  //  * but because of how I've chosen to design the order cancellation flow
-  //  * we expect the FIFO containing those orders to still have them, granted at .qty == 0.
-  std::string assert_str1("Expected order_count == 0. Found: " +
-                          std::to_string(test_book.order_count()));
-  assertm(test_book.empty(), assert_str1.c_str());
-  std::string assert_str2("Expected FIFOs size == " +
-                          std::to_string(num_orders));
-  assertm(test_book.fifos_size() == num_orders, assert_str2.c_str());
+  //  * Verify that the order_count is that of the survivor,
+  //  * and that only std::deque FIFOs hold on to cancelled orders, no more
+  //  * than compaction lets them.
+  std::string assert_str1("Expected order_count == " +
+                          std::to_string(order_quantity) +
+                          ". Found: " + std::to_string(test_book.order_count()));
+  assertm(test_book.order_count() == order_quantity, assert_str1.c_str());
+  constexpr size_t queued = levelmap::MinLevelMap::kIntrusive
+                                ? 1LU
+                                : 1 + levelmap::kCompactTombstones;
+  std::string assert_str2("Expected FIFOs size <= " + std::to_string(queued));
+  assertm(test_book.fifos_size() <= queued, assert_str2.c_str());
 
-  order::Order dummy_order{24, "IBM", order::OrderSide::kSell, 10, 99.00};
+  order::Order dummy_order{24, kDefaultSymbol, order::OrderSide::kSell,
+                           order_quantity, 99 * order::kPriceScale};
   order::OrderResult result{};
 
-  //  * 4. Cross an order that would otherwise have been filled by the cancelled orders.
+  //  * 4. Cross an order that fills the survivor behind the cancelled orders.
   test_book.place_order(&dummy_order, &result);
+  assertm(result.fills.size() == 1, "Expected to fill the survivor");
+  assertm(result.fills[0].resting == dummy_buys.back().oid,
+          "Expected the survivor to be the resting side of the fill");
 
-  std::string assert_str3("Expected FIFOs size == 1");
-  //  * 5. Verify that the cancelled orders were popped off their fifos.
-  assertm(test_book.fifos_size() == 1, assert_str3.c_str());
+  std::string assert_str3("Expected FIFOs size == 0");
+  //  * 5. Verify that no cancelled orders are left in the fifos.
+  assertm(test_book.fifos_size() == 0, assert_str3.c_str());
 
-  //  * 6. Cross one more order to fill the one placed in Step 4.
+  //  * 6. Place and kill one more order.
   dummy_order.side = order::OrderSide::kBuy;
+  dummy_order.qty = order_quantity;
   test_book.place_order(&dummy_order, &result);
+  assertm(test_book.maps_size() == 1, "Expected the order to be booked");
+  test_book.kill_order(dummy_order);
 
   //  * 7. Verify that all of our data structures and counts corroborate (0, empty).
   std::string assert_str4("Expected order_count == 0: " +
@@ -64,7 +76,7 @@ int main(int argc, char* argv[])
   std::string assert_str5("Expected FIFOs size == 0: " +
                           std::to_string(test_book.fifos_size()));
   std::string assert_str6("Expected FIFO maps size == 0: " +
-                          std::to_string(test_book.fifos_size()));
+                          std::to_string(test_book.maps_size()));
   assertm(test_book.empty() && (test_book.order_count() == 0),
           assert_str4.c_str());
   assertm(test_book.fifos_empty() && (test_book.fifos_size() == 0),
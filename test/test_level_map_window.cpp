@@ -0,0 +1,147 @@
+#include <cstddef>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <order_book.h>
+#include <order.h>
+#include <level_map.h>
+#include "test_utils.h"
+
+/**
+ * test_level_map_window:
+ * 1. Books levels both inside the tick window and far outside of it so
+ *    that some of them spill into the sparse map.
+ * 2. Verifies that level visitation is sorted across window and spill.
+ * 3. Verifies that the first level for either side is the extreme price.
+ * 4. Drains the levels from the best one out, like a sweep, and checks
+ *    the window follows the best level, adopting spilled levels that now
+ *    fall inside of it, and that a push near the last level lands in it.
+ * 5. Books the same prices on a MaxLevelMap (bids) and verifies that it
+ *    visits them highest first and that its best level is the highest.
+ * 6. Matches a book with gen_actions.py's prices (every 5th decimal used,
+ *    sigma $0.25 around a mean that drifts by $2) and checks that both
+ *    best levels are in the window after every order.
+*/
+int main(int argc, char* argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  const order::price_t tick = 1;
+  const order::price_t base = 100 * order::kPriceScale;
+  const std::vector<order::price_t> prices{
+      base,
+      base + 7 * tick,
+      base - 3 * tick,
+      base + static_cast<order::price_t>(levelmap::kWindowLevels) * tick,
+      base - static_cast<order::price_t>(levelmap::kWindowLevels) * tick,
+      base + 50 * order::kPriceScale,
+      base - 50 * order::kPriceScale,
+  };
+
+  levelmap::MinLevelMap levels{};
+  order::oid_t oid = 0;
+  for (auto price : prices) {
+    levels.push_back_with_key(price, order::Order{oid++, kDefaultSymbol,
+                                                  order::OrderSide::kBuy, 10,
+                                                  price});
+  }
+  assertm(levels.map_size() == prices.size(), "Expected one level per price");
+  assertm(levels.order_count() == 10 * prices.size(), "Expected qty tally");
+
+  std::vector<order::price_t> visited;
+  levels.rfor_each_level(
+      [&](order::price_t price, const auto&) { visited.push_back(price); });
+  assertm(visited.size() == prices.size(), "Expected to visit every level");
+  assertm(std::is_sorted(visited.rbegin(), visited.rend()),
+          "Expected descending visitation");
+
+  visited.clear();
+  levels.for_each_level(
+      [&](order::price_t price, const auto&) { visited.push_back(price); });
+  assertm(std::is_sorted(visited.begin(), visited.end()),
+          "Expected ascending visitation");
+
+  order::Order buy{oid++, kDefaultSymbol, order::OrderSide::kBuy, 1, base};
+  order::Order sell{oid++, kDefaultSymbol, order::OrderSide::kSell, 1, base};
+  assertm(levels.get_first_level(&buy).first == visited.front(),
+          "Expected lowest level first for buys");
+  assertm(levels.get_first_level(&sell).first == visited.back(),
+          "Expected highest level first for sells");
+
+  assertm(levels.in_window(visited.front()),
+          "Expected the best level in the window");
+  // Drain everything but the high outlier, best level first.
+  for (size_t i = 0; i + 1 < visited.size(); ++i) {
+    levels.erase(visited[i]);
+    assertm(levels.in_window(levels.best_level().first),
+            "Expected the window to follow the best level");
+  }
+  assertm(levels.map_size() == 1, "Expected only the high outlier");
+
+  auto near_high = visited.back() - 5 * tick;
+  levels.push_back_with_key(
+      near_high, order::Order{oid++, kDefaultSymbol, order::OrderSide::kBuy,
+                              10, near_high});
+  assertm(levels.map_size() == 2, "Expected a new level");
+  assertm(levels.in_window(near_high) && levels.in_window(visited.back()),
+          "Expected both levels in the window");
+  assertm(levels.get_first_level(&sell).first == visited.back(),
+          "Expected the outlier to remain the highest level");
+  assertm(levels.get_first_level(&buy).first == near_high,
+          "Expected the new level to be the lowest level");
+  assertm(levels.get_level(near_high).num_orders == 10,
+          "Expected to find the new level by key");
+
+  levelmap::MaxLevelMap bids{};
+  for (auto price : prices) {
+    bids.push_back_with_key(price, order::Order{oid++, kDefaultSymbol,
+                                                order::OrderSide::kBuy, 10,
+                                                price});
+  }
+  std::vector<order::price_t> descending;
+  bids.for_each_level(
+      [&](order::price_t price, const auto&) { descending.push_back(price); });
+  assertm(descending.size() == prices.size(), "Expected every bid level");
+  assertm(std::is_sorted(descending.rbegin(), descending.rend()),
+          "Expected bids highest first");
+  assertm(bids.best_level().first == descending.front(),
+          "Expected the highest bid to be the best level");
+  bids.erase(descending.front());
+  assertm(bids.best_level().first == descending[1],
+          "Expected the next highest bid after erasing the best");
+
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<int> coin(0, 1);
+  std::uniform_int_distribution<order::qty_t> qty(1, 100);
+  constexpr int kOrders = 50000;
+  order::OrderBook book;
+  order::OrderResult result;
+  size_t book_levels = 0;
+  for (int i = 0; i < kOrders; ++i) {
+    double mean = 42.0 + 2.0 * i / kOrders;
+    std::normal_distribution<double> price(mean, 0.25);
+    order::Order o{oid++, kDefaultSymbol,
+                   coin(gen) ? order::OrderSide::kBuy
+                             : order::OrderSide::kSell,
+                   qty(gen),
+                   static_cast<order::price_t>(std::llround(
+                       price(gen) * static_cast<double>(order::kPriceScale)))};
+    book.place_order(&o, &result);
+    const auto &asks = book.get_sell_orders();
+    const auto &bids = book.get_buy_orders();
+    assertm(asks.map_empty() || asks.in_window(asks.best_level().first),
+            "Expected the best ask in the window");
+    assertm(bids.map_empty() || bids.in_window(bids.best_level().first),
+            "Expected the best bid in the window");
+    book_levels += asks.map_size() + bids.map_size();
+  }
+  ostream << "levels on the book, averaged: " << book_levels / kOrders
+          << '\n';
+
+  return 0;
+}
@@ -0,0 +1,58 @@
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <order.h>
+#include <oid_index.h>
+#include "test_utils.h"
+
+/**
+ * test_oid_index:
+ * 1. Inserts a dense run of OIDs spanning several pages plus the largest OID.
+ * 2. Verifies look-ups, overwrites, and misses.
+ * 3. Erases every OID and verifies that the index is empty again.
+ * 4. Reuses the OIDs, which should pick up where the spare page left off.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  constexpr order::oid_t num_oids = 3 * 4096 + 7;
+  order::OidIndex<order::price_t> index{};
+
+  for (order::oid_t oid = 0; oid < num_oids; ++oid) {
+    index.insert(oid, oid * 2);
+  }
+  index.insert(order::kMaxOID, 42);
+  assertm(index.size() == num_oids + 1, "Expected one entry per OID");
+
+  for (order::oid_t oid = 0; oid < num_oids; ++oid) {
+    const auto *ref = index.find(oid);
+    assertm(ref != nullptr && *ref == oid * 2, "Expected to find every OID");
+  }
+  assertm(*index.find(order::kMaxOID) == 42, "Expected to find the max OID");
+  assertm(!index.contains(num_oids), "Expected a miss past the run");
+  assertm(!index.contains(order::kMaxOID - 1), "Expected a miss in a page");
+
+  index.insert(7, 1);
+  assertm(*index.find(7) == 1, "Expected insert to overwrite");
+  assertm(index.size() == num_oids + 1, "Expected overwrite to keep size");
+
+  for (order::oid_t oid = 0; oid < num_oids; ++oid) {
+    assertm(index.erase(oid), "Expected to erase every OID");
+  }
+  assertm(!index.erase(0), "Expected a second erase to miss");
+  assertm(index.erase(order::kMaxOID), "Expected to erase the max OID");
+  assertm(index.empty(), "Expected an empty index");
+  assertm(!index.contains(7), "Expected erased OIDs to miss");
+
+  for (order::oid_t oid = num_oids; oid < 2 * num_oids; ++oid) {
+    index.insert(oid, oid);
+  }
+  assertm(index.size() == num_oids, "Expected the reused OIDs");
+  assertm(*index.find(2 * num_oids - 1) == 2 * num_oids - 1,
+          "Expected to find the last reused OID");
+
+  return 0;
+}
@@ -0,0 +1,118 @@
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <variant>
+#include <order.h>
+#include <symbol_table.h>
+#include <simple_cross.h>
+#include "test_utils.h"
+
+static std::string first_error(std::string_view line,
+                               order::SymbolTable* symbols)
+{
+  results_t err;
+  deserialize_action(line, &err, symbols);
+  return err.empty() ? "" : err.front();
+}
+
+/**
+ * test_parser:
+ * 1. Decodes well formed actions into the matching Action alternative,
+ *    prints of one book with and without a depth included.
+ * 2. Checks the error texts for each kind of malformed action. Prices
+ *    must be [+-]digits[.digits] and nothing else: unlike std::stod, a
+ *    price with anything after its digits is rejected.
+ * 3. Checks that only valid orders intern their symbol, prints only look
+ *    theirs up.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  order::SymbolTable symbols{};
+  results_t err;
+
+  auto action = deserialize_action("O 10001 IBM B 10 99.5", &err, &symbols);
+  const auto *place = std::get_if<PlaceOrderAction>(&action);
+  assertm(err.empty() && place != nullptr, "Expected a place order");
+  assertm(place->order.oid == 10001, "Expected the OID");
+  assertm(symbols.name(place->order.symbol) == "IBM", "Expected the symbol");
+  assertm(place->order.side == order::OrderSide::kBuy, "Expected a buy");
+  assertm(place->order.qty == 10, "Expected the quantity");
+  assertm(place->order.price == 995 * order::kPriceScale / 10,
+          "Expected the price in ticks");
+
+  action = deserialize_action("X\t10002 ", &err, &symbols);
+  const auto *cancel = std::get_if<CancelOrderAction>(&action);
+  assertm(cancel != nullptr && cancel->oid == 10002, "Expected a cancel");
+  action = deserialize_action("P", &err, &symbols);
+  assertm(std::holds_alternative<PrintAction>(action), "Expected a print");
+  assertm(std::get<PrintAction>(action).symbol == order::kInvalidSymbol,
+          "Expected every book");
+  action = deserialize_action("P IBM 5", &err, &symbols);
+  const auto *print = std::get_if<PrintAction>(&action);
+  assertm(print != nullptr && print->symbol == symbols.find("IBM") &&
+              print->depth == 5,
+          "Expected the best 5 levels of IBM");
+  action = deserialize_action("P IBM", &err, &symbols);
+  print = std::get_if<PrintAction>(&action);
+  assertm(print != nullptr && print->depth == 0, "Expected all of IBM");
+  action = deserialize_action(" \t", &err, &symbols);
+  assertm(std::holds_alternative<NopAction>(action), "Expected a no-op");
+  assertm(err.empty(), "Expected no errors so far");
+
+  assertm(first_error("K 1 IBM B 10 1.0", &symbols) ==
+              "Invalid action: K 1 IBM B 10 1.0...",
+          "Expected an invalid action");
+  assertm(first_error("P ", &symbols) ==
+              "Invalid Print Action request size: P ...",
+          "Expected an invalid print");
+  assertm(first_error("P @$ 1", &symbols) == "Invalid Symbol: @$",
+          "Expected an invalid print symbol");
+  assertm(first_error("P IBM 0", &symbols) ==
+              "Invalid Print Action depth: 0",
+          "Expected an invalid depth");
+  assertm(first_error("P IBM 65536", &symbols) ==
+              "Invalid Print Action depth: 65536",
+          "Expected a depth out of range");
+  assertm(first_error("P IBM 1 2", &symbols) ==
+              "Invalid Print Action request size: P IBM 1 2...",
+          "Expected trailing tokens to be rejected");
+  assertm(first_error("O 1 @$ B 10 1.0", &symbols) == "Invalid Symbol: @$",
+          "Expected an invalid symbol");
+  assertm(first_error("O x IBM B 10 1.0", &symbols) == "Invalid Symbol: ",
+          "Expected a bad OID to take the symbol down with it");
+  assertm(first_error("O 1 IBM Q 10 1.0", &symbols) ==
+              "1 Invalid order side: O",
+          "Expected an invalid side");
+  assertm(first_error("O 1 IBM Buy 10 1.0", &symbols) ==
+              "1 Invalid quantity format: uy",
+          "Expected the side to be a single character");
+  assertm(first_error("O 1 IBM B", &symbols) == "1 Invalid quantity format: ",
+          "Expected a missing quantity");
+  assertm(first_error("O 1 IBM S 65536 1.0", &symbols) ==
+              "1 Quantity out of valid range: 65536",
+          "Expected a quantity out of range");
+  assertm(first_error("O 1 IBM S 10 -1.0", &symbols) ==
+              "1 Price <= 0 || > 9999999.99999 ",
+          "Expected a price out of range");
+  assertm(first_error("O 1 MSFT S 10 1e2", &symbols) ==
+              "1 Price <= 0 || > 9999999.99999 ",
+          "Expected a malformed price");
+  for (const char *price : {"99.0abc", "99.0.5", "99\xff", "\xe9"}) {
+    assertm(first_error(std::string("O 1 MSFT S 10 ") + price, &symbols) ==
+                "1 Price <= 0 || > 9999999.99999 ",
+            "Expected trailing garbage and high-bit bytes to be rejected");
+  }
+
+  action = deserialize_action("P MSFT 2", &err, &symbols);
+  print = std::get_if<PrintAction>(&action);
+  assertm(print != nullptr && print->symbol == order::kInvalidSymbol &&
+              print->key == order::pack_symbol("MSFT"),
+          "Expected a print of a symbol never ordered on to keep its name");
+  assertm(symbols.size() == 1, "Expected only IBM to be interned");
+
+  return 0;
+}
@@ -26,14 +26,13 @@ int main(int argc, char *argv[])
   test_book.place_order(&dummy_sell, &result);
 
   assertm(result.type == order::ResultType::kFilled, "Expected filled result");
-  assertm(result.orders.size() == 2, "Expected two filled orders");
-  assertm(result.orders[0].side == order::OrderSide::kSell,
-          "Expected sell order first");
-  assertm(result.orders[1].side == order::OrderSide::kBuy,
-          "Expected buy order second");
-  assertm(result.orders[0].qty == order_quantity / 2,
-          "Expected half filled order");
-  assertm(result.orders[1].qty == order_quantity / 2,
+  assertm(result.fills.size() == 1, "Expected one fill");
+  assertm(result.fills[0].side == order::OrderSide::kSell,
+          "Expected the sell order to be the aggressor");
+  assertm(result.fills[0].aggressor == dummy_sell.oid &&
+              result.fills[0].resting == dummy_buy.oid,
+          "Expected the buy order to be resting");
+  assertm(result.fills[0].qty == order_quantity / 2,
           "Expected half filled order");
 
   return 0;
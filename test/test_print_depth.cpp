@@ -0,0 +1,81 @@
+#include <cstddef>
+#include <fstream>
+#include <list>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <result_sink.h>
+#include <simple_cross.h>
+#include "test_utils.h"
+
+static std::list<std::string> run(SimpleCross *scross,
+                                  const std::vector<std::string_view> &lines)
+{
+  std::list<std::string> out;
+  order::ListSink sink(&out);
+  scross->actions(lines, &sink);
+  return out;
+}
+
+/**
+ * Keeps the lines of a full P that are about symbol.
+*/
+static std::list<std::string> only(const std::list<std::string> &lines,
+                                   const std::string &symbol)
+{
+  std::list<std::string> result;
+  for (const auto &line : lines) {
+    if (line.find(" " + symbol + " ") != std::string::npos) {
+      result.push_back(line);
+    }
+  }
+  return result;
+}
+
+/**
+ * test_print_depth:
+ * 1. Books three ask and three bid levels on IBM, one of them far enough
+ *    out to spill out of the tick window, two orders on one level, and a
+ *    cancelled order, plus an AAPL book.
+ * 2. Checks P IBM against the IBM lines of a full P.
+ * 3. Checks P IBM 2 prints the best two levels of each side, in the same
+ *    order as a full P, and that a depth past the book prints all of it.
+ * 4. Checks that a print of a symbol without a book prints nothing, and
+ *    that books are printed in the order their symbols were first seen.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  SimpleCross scross;
+  run(&scross, {"O 1 IBM S 5 101.00000", "O 2 IBM S 6 102.00000",
+                "O 3 IBM S 7 9000.00000", "O 4 IBM B 8 99.00000",
+                "O 5 IBM B 9 99.00000", "O 6 IBM B 1 98.00000",
+                "O 7 IBM B 2 97.00000", "O 8 AAPL S 3 50.00000",
+                "O 9 IBM B 4 98.50000", "X 9"});
+  auto full = run(&scross, {"P"});
+  for (const auto &line : full) {
+    ostream << line << '\n';
+  }
+  assertm(full.size() == 8, "Expected every resting order");
+  assertm(full.front().find(" AAPL ") == std::string::npos,
+          "Expected IBM, seen first, to print first");
+  assertm(run(&scross, {"P IBM"}) == only(full, "IBM"),
+          "Expected the IBM book");
+
+  std::list<std::string> expected = {
+      "P 2 IBM S 6 102.00000", "P 1 IBM S 5 101.00000",
+      "P 4 IBM B 8 99.00000",  "P 5 IBM B 9 99.00000",
+      "P 6 IBM B 1 98.00000"};
+  assertm(run(&scross, {"P IBM 2"}) == expected,
+          "Expected the best two levels a side");
+  assertm(run(&scross, {"P IBM 1000"}) == only(full, "IBM"),
+          "Expected a deep print to print the whole book");
+  assertm(run(&scross, {"P AAPL 1"}) == only(full, "AAPL"),
+          "Expected the AAPL book");
+  assertm(run(&scross, {"P MSFT 3"}).empty(), "Expected no MSFT book");
+
+  return 0;
+}
@@ -0,0 +1,87 @@
+#include <cstddef>
+#include <fstream>
+#include <list>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <order.h>
+#include <result_sink.h>
+#include "test_utils.h"
+
+/**
+ * test_result_sink:
+ * Sends the same fills, cancels, errors, P and L lines, and plain lines to a
+ * ListSink and to a BufferSink backed by a file, enough of them to flush a
+ * few times, and checks that the file holds exactly the ListSink lines.
+ * Then checks that a flush that can't write throws.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  std::string path = std::string(argv[0]) + ".out";
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  assertm(fd >= 0, "Expected to open the output file");
+
+  const order::price_t prices[] = {1,
+                                   order::kPriceScale,
+                                   order::kPriceScale + 10,
+                                   99 * order::kPriceScale + 99999,
+                                   order::kMaxPrice};
+  std::list<std::string> lines;
+  {
+    order::ListSink list_sink(&lines);
+    order::OutputBuffer out(fd);
+    order::BufferSink buffer_sink(&out);
+    order::ResultSink *sinks[] = {&list_sink, &buffer_sink};
+    for (order::oid_t oid = 0; oid < 20000; ++oid) {
+      order::Order fill{oid, 0, order::OrderSide::kBuy,
+                        static_cast<order::qty_t>(oid), prices[oid % 5]};
+      for (auto *sink : sinks) {
+        sink->fill(fill, "IBM");
+        sink->cancel(order::kMaxOID - oid);
+        sink->error(order::ErrorCode::kInvalidOid, oid);
+        sink->book_order(fill, "AAPL");
+        sink->level(order::LevelDepth{fill.price, oid, 1,
+                                      order::OrderSide::kSell},
+                    "MSFT");
+        sink->line("Invalid Symbol: @$");
+      }
+    }
+  }
+  ::close(fd);
+
+  std::string expected;
+  for (const auto &line : lines) {
+    expected += line + '\n';
+  }
+  std::ifstream written(path, std::ios::in | std::ios::binary);
+  std::stringstream actual_stream;
+  actual_stream << written.rdbuf();
+  std::string actual = actual_stream.str();
+  assertm(actual.size() > 4 * order::kFlushSize, "Expected several flushes");
+  assertm(actual == expected, "Expected identical output");
+  assertm(lines.front() == "F 0 IBM 0 0.00001", "Expected a padded price");
+
+  int read_only = ::open(path.c_str(), O_RDONLY);
+  assertm(read_only >= 0, "Expected to reopen the output file");
+  {
+    order::OutputBuffer out(read_only);
+    out.append("lost\n");
+    bool threw = false;
+    try {
+      out.flush();
+    } catch (const std::system_error &) {
+      threw = true;
+    }
+    assertm(threw, "Expected the failed write to be reported");
+    assertm(out.empty(), "Expected what wasn't written to be dropped");
+  }
+  ::close(read_only);
+
+  return 0;
+}
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+#include <fstream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <result_sink.h>
+#include <symbol_table.h>
+#include <sharded_cross.h>
+#include <simple_cross.h>
+#include <wire.h>
+#include "test_utils.h"
+
+/**
+ * A seeded mix of orders on a handful of symbols with a small OID range,
+ * so that OIDs keep getting reused across symbols (and shards) while they
+ * may or may not still be resting, plus cancels, prints, and bad lines.
+*/
+static std::vector<std::string> generate_lines(size_t n, unsigned seed)
+{
+  std::mt19937 gen(seed);
+  auto pick = [&](unsigned bound) {
+    return std::uniform_int_distribution<unsigned>(0, bound - 1)(gen);
+  };
+  const char *symbols[] = {"IBM", "AAPL", "MSFT", "GOOG", "A1", "Z9", "QQQ"};
+  std::vector<std::string> lines;
+  for (size_t i = 0; i < n; ++i) {
+    auto oid = std::to_string(1 + pick(300));
+    auto roll = pick(100);
+    if (roll < 70) {
+      lines.push_back("O " + oid + " " + symbols[pick(7)] + " " +
+                      (pick(2) ? "B " : "S ") + std::to_string(1 + pick(20)) +
+                      " " + std::to_string(95 + pick(10)) + ".5");
+    } else if (roll < 95) {
+      lines.push_back("X " + oid);
+    } else if (roll < 96) {
+      lines.push_back("P");
+    } else if (roll < 98) {
+      // One book, all of it or its best levels.
+      auto line = std::string("P ") + symbols[pick(7)];
+      if (pick(2)) {
+        line += ' ';
+        line += std::to_string(1 + pick(3));
+      }
+      lines.push_back(line);
+    } else {
+      lines.push_back("O " + oid + " IBM B 0x 1.0");
+    }
+  }
+  return lines;
+}
+
+static std::string run_single(const std::vector<std::string_view> &lines,
+                              bool binary)
+{
+  order::OutputBuffer out;
+  SimpleCross scross;
+  if (binary) {
+    wire::BinarySink sink(&out);
+    scross.messages(lines, &sink);
+  } else {
+    order::BufferSink sink(&out);
+    scross.actions(lines, &sink);
+  }
+  return std::string(out.view());
+}
+
+static double cpu_seconds()
+{
+  timespec ts{};
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return static_cast<double>(ts.tv_sec) +
+         1e-9 * static_cast<double>(ts.tv_nsec);
+}
+
+static std::string run_sharded(const std::vector<std::string_view> &lines,
+                               bool binary, size_t shards)
+{
+  order::OutputBuffer out;
+  {
+    ShardedCross scross(shards,
+                        binary ? ShardedCross::Format::kBinary
+                               : ShardedCross::Format::kText,
+                        &out);
+    // Odd sized batches, like the ingest layer would hand over.
+    const size_t batch_size = 1000;
+    for (size_t i = 0; i < lines.size(); i += batch_size) {
+      auto end = std::min(lines.size(), i + batch_size);
+      std::vector<std::string_view> batch(lines.data() + i,
+                                          lines.data() + end);
+      if (binary) {
+        scross.messages(batch);
+      } else {
+        scross.actions(batch);
+      }
+    }
+  }
+  return std::string(out.view());
+}
+
+/**
+ * test_sharded_cross:
+ * Runs the same text and binary actions through SimpleCross and through
+ * ShardedCross with 1, 2, 3, and 8 shards, and checks that the output is
+ * byte for byte the same. Then leaves 4 shards without input for a while
+ * and checks their workers sleep instead of burning a core each, and
+ * wake up for the next batch.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  auto text = generate_lines(50000, 12345);
+  std::vector<std::string_view> lines(text.begin(), text.end());
+
+  order::SymbolTable symbols;
+  results_t err;
+  std::vector<std::string> encoded;
+  for (auto line : lines) {
+    err.clear();
+    auto action = deserialize_action(line, &err, &symbols);
+    wire::Message msg;
+    if (err.empty() && wire::encode_action(action, symbols, &msg)) {
+      std::string bytes(wire::kMessageSize, '\0');
+      wire::encode(msg, bytes.data());
+      encoded.push_back(bytes);
+    }
+  }
+  std::vector<std::string_view> messages(encoded.begin(), encoded.end());
+
+  auto expected_text = run_single(lines, false);
+  auto expected_binary = run_single(messages, true);
+  assertm(expected_text.find("\nF ") != std::string::npos,
+          "Expected some fills");
+  assertm(expected_text.find("Duplicate order id") != std::string::npos,
+          "Expected some duplicate OIDs");
+  const size_t shard_counts[] = {1, 2, 3, 8};
+  for (auto shards : shard_counts) {
+    ostream << "shards: " << shards << '\n';
+    assertm(run_sharded(lines, false, shards) == expected_text,
+            "Expected the same text output");
+    assertm(run_sharded(messages, true, shards) == expected_binary,
+            "Expected the same binary output");
+  }
+
+  order::OutputBuffer out;
+  {
+    ShardedCross idle(4, ShardedCross::Format::kText, &out);
+    idle.actions({"O 1 IBM B 10 99.0"});
+    idle.finish();
+    auto before = cpu_seconds();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    auto idle_cpu = cpu_seconds() - before;
+    ostream << "idle cpu: " << idle_cpu << "s\n";
+    assertm(idle_cpu < 0.3, "Expected idle workers to sleep");
+    idle.actions({"O 2 IBM S 10 99.0"});
+    idle.finish();
+  }
+  assertm(out.view() == "F 2 IBM 10 99.00000\nF 1 IBM 10 99.00000\n",
+          "Expected sleeping workers to wake up for new actions");
+
+  return 0;
+}
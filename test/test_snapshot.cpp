@@ -0,0 +1,106 @@
+#include <cstddef>
+#include <fstream>
+#include <list>
+#include <string>
+#include <order_book.h>
+#include <order.h>
+#include <result_sink.h>
+#include "test_utils.h"
+
+static std::list<std::string> run(order::BookMap *books,
+                                  std::vector<order::Order> orders)
+{
+  std::list<std::string> lines;
+  order::ListSink sink(&lines);
+  order::OrderResult result;
+  for (auto &o : orders) {
+    books->handle_order(&o, &result);
+    result.serialize(books->symbols(), &sink);
+  }
+  return lines;
+}
+
+/**
+ * test_snapshot:
+ * 1. Books orders on a few symbols and levels (inside the tick window and
+ *    spilled), partially fills some, and cancels some so deque FIFOs hold
+ *    tombstones.
+ * 2. Saves a snapshot, loads it into an empty BookMap, and checks that
+ *    both print the same book and know the same OIDs.
+ * 3. Sweeps and cancels on both and checks that the fills come out in the
+ *    same (FIFO) order and the cancels find their orders.
+ * 4. Checks that truncated and non-empty loads are rejected.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  using order::OrderSide;
+  const order::price_t base = 100 * order::kPriceScale;
+  const order::price_t far = base + 100000 * order::kPriceScale;
+  order::BookMap original;
+  auto ibm = original.symbols().intern("IBM");
+  auto aapl = original.symbols().intern("AAPL");
+  original.symbols().intern("UNUSED");
+  std::vector<order::Order> orders;
+  order::oid_t oid = 1;
+  for (order::price_t i = 0; i < 5; ++i) {
+    for (size_t n = 0; n < 4; ++n) {
+      orders.emplace_back(oid++, ibm, OrderSide::kBuy, 10, base - i);
+      orders.emplace_back(oid++, ibm, OrderSide::kSell, 10, base + 1 + i);
+      orders.emplace_back(oid++, aapl, OrderSide::kSell, 7, far + i);
+    }
+  }
+  // Partially fills the best IBM bid.
+  orders.emplace_back(oid++, ibm, OrderSide::kSell, 3, base);
+  run(&original, orders);
+  order::OrderResult result;
+  for (order::oid_t cancel = 2; cancel < oid; cancel += 5) {
+    original.cancel_order(cancel, &result);
+  }
+
+  std::string snapshot;
+  original.save(&snapshot);
+  ostream << "snapshot bytes: " << snapshot.size() << '\n';
+  order::BookMap loaded;
+  std::string err;
+  assertm(loaded.load(snapshot, &err), "Expected the snapshot to load");
+  assertm(loaded.symbols().size() == 3, "Expected every symbol back");
+  assertm(loaded.serialize() == original.serialize(),
+          "Expected the same books");
+  for (order::oid_t o = 1; o < oid; ++o) {
+    assertm(loaded.contains(o) == original.contains(o),
+            "Expected the same OIDs resting");
+  }
+
+  std::vector<order::Order> sweep = {
+      {oid, ibm, OrderSide::kSell, 60, base - 4},
+      {oid + 1, ibm, OrderSide::kBuy, 45, base + 5},
+      {oid + 2, aapl, OrderSide::kBuy, 20, far + 2},
+  };
+  auto expected = run(&original, sweep);
+  auto actual = run(&loaded, sweep);
+  for (const auto &line : actual) {
+    ostream << line << '\n';
+  }
+  assertm(expected.size() > 6, "Expected fills");
+  assertm(actual == expected, "Expected the same fills in the same order");
+  for (order::oid_t o = 1; o < oid; ++o) {
+    order::OrderResult a, b;
+    original.cancel_order(o, &a);
+    loaded.cancel_order(o, &b);
+    assertm(a.type == b.type, "Expected the same cancels");
+  }
+  assertm(loaded.serialize().empty(), "Expected an empty book");
+
+  order::BookMap truncated;
+  assertm(!truncated.load(snapshot.substr(0, snapshot.size() - 1), &err),
+          "Expected a truncated snapshot to be rejected");
+  order::BookMap busy;
+  run(&busy, {{1, busy.symbols().intern("IBM"), OrderSide::kBuy, 1, base}});
+  assertm(!busy.load(snapshot, &err), "Expected books in use to refuse");
+
+  return 0;
+}
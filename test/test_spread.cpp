@@ -0,0 +1,76 @@
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <order_book.h>
+#include <order.h>
+#include "test_utils.h"
+
+/**
+ * test_spread:
+ * Walks the top of the book through inserts, fills, and cancels and checks
+ * that get_spread reports the best bid and best ask after every step.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  const order::price_t unit = order::kPriceScale;
+  order::OrderBook test_book{};
+  order::OrderResult result{};
+  using spread_t = std::pair<order::price_t, order::price_t>;
+
+  assertm(test_book.get_spread() == spread_t(0, 0), "Expected empty sides");
+
+  order::Order bid_99{0, kDefaultSymbol, order::OrderSide::kBuy, 10, 99 * unit};
+  order::Order bid_100{1, kDefaultSymbol, order::OrderSide::kBuy, 10,
+                       100 * unit};
+  order::Order ask_101{2, kDefaultSymbol, order::OrderSide::kSell, 10,
+                       101 * unit};
+  order::Order ask_102{3, kDefaultSymbol, order::OrderSide::kSell, 10,
+                       102 * unit};
+  test_book.place_order(&bid_99, &result);
+  assertm(test_book.get_spread() == spread_t(99 * unit, 0),
+          "Expected a one sided book");
+  test_book.place_order(&ask_102, &result);
+  test_book.place_order(&bid_100, &result);
+  test_book.place_order(&ask_101, &result);
+  assertm(test_book.get_spread() == spread_t(100 * unit, 101 * unit),
+          "Expected the inner prices");
+
+  // Fully fill the best bid, the next bid takes over.
+  order::Order sell_100{4, kDefaultSymbol, order::OrderSide::kSell, 10,
+                        100 * unit};
+  test_book.place_order(&sell_100, &result);
+  assertm(test_book.get_spread() == spread_t(99 * unit, 101 * unit),
+          "Expected the best bid to move down a level");
+
+  // Partially fill the best ask, it stays put.
+  order::Order buy_101{5, kDefaultSymbol, order::OrderSide::kBuy, 5,
+                       101 * unit};
+  test_book.place_order(&buy_101, &result);
+  assertm(test_book.get_spread() == spread_t(99 * unit, 101 * unit),
+          "Expected the best ask to hold");
+
+  // Cancel what is left of the best ask.
+  test_book.kill_order(ask_101);
+  assertm(test_book.get_spread() == spread_t(99 * unit, 102 * unit),
+          "Expected the best ask to move up a level");
+
+  // Improve the bid from far outside of the tick window.
+  order::Order bid_far{6, kDefaultSymbol, order::OrderSide::kBuy, 10,
+                       101 * unit + 1};
+  test_book.place_order(&bid_far, &result);
+  assertm(test_book.get_spread() == spread_t(101 * unit + 1, 102 * unit),
+          "Expected the improved bid");
+
+  test_book.kill_order(bid_far);
+  test_book.kill_order(bid_99);
+  test_book.kill_order(ask_102);
+  assertm(test_book.get_spread() == spread_t(0, 0), "Expected empty sides");
+  assertm(test_book.maps_empty(), "Expected every level to be dropped");
+
+  return 0;
+}
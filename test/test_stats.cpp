@@ -0,0 +1,80 @@
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <order_book.h>
+#include <order.h>
+#include <stats.h>
+#include "test_utils.h"
+
+/**
+ * test_stats:
+ * 1. Records 1..100000 into a Histogram and checks that every percentile
+ *    is within one bucket (1/16th) above the exact value.
+ * 2. In an SC_STATS build, runs fills, new and emptied levels, and a cancel
+ *    miss through a BookMap and checks the counters moved by exactly that
+ *    much. Otherwise checks that nothing was counted.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  stats::Histogram histogram;
+  assertm(histogram.percentile(0.5) == 0, "Expected 0 without samples");
+  constexpr uint64_t num_samples = 100000;
+  for (uint64_t value = 1; value <= num_samples; ++value) {
+    histogram.record(value);
+  }
+  assertm(histogram.count() == num_samples, "Expected every sample counted");
+  for (double p : {0.01, 0.5, 0.9, 0.99, 0.999, 1.0}) {
+    auto exact = static_cast<uint64_t>(p * num_samples);
+    auto reported = histogram.percentile(p);
+    ostream << p << ": " << reported << " (" << exact << ")\n";
+    assertm(reported >= exact && reported <= exact + exact / 16,
+            "Expected percentiles within a bucket");
+  }
+  stats::Histogram small;
+  for (uint64_t value = 0; value < 16; ++value) {
+    small.record(value);
+  }
+  assertm(small.percentile(1.0) == 15, "Expected small values to be exact");
+
+  auto before = stats::Registry::instance().total();
+  order::BookMap books;
+  auto ibm = books.symbols().intern("IBM");
+  order::OrderResult result;
+  const order::price_t price = 100 * order::kPriceScale;
+  order::Order sell{1, ibm, order::OrderSide::kSell, 10, price};
+  order::Order buys[] = {{2, ibm, order::OrderSide::kBuy, 4, price + 1},
+                         {3, ibm, order::OrderSide::kBuy, 4, price + 1}};
+  books.handle_order(&sell, &result);
+  books.handle_order(&buys[0], &result);
+  books.handle_order(&buys[1], &result);
+  books.cancel_order(1, &result);
+  books.cancel_order(1, &result);
+  auto after = stats::Registry::instance().total();
+  auto moved = [&](stats::Counter counter) {
+    auto i = static_cast<size_t>(counter);
+    return after->counters[i].load() - before->counters[i].load();
+  };
+  std::ostringstream dump;
+  stats::dump(dump);
+  ostream << dump.str();
+#ifdef SC_STATS
+  assertm(moved(stats::Counter::kFills) == 2, "Expected two fills");
+  assertm(moved(stats::Counter::kLevelsCreated) == 1, "Expected one level");
+  assertm(moved(stats::Counter::kLevelsErased) == 1,
+          "Expected the level to go with the cancel");
+  assertm(moved(stats::Counter::kOidMisses) == 1, "Expected one miss");
+#else
+  for (size_t i = 0; i < stats::kCounters; ++i) {
+    assertm(moved(static_cast<stats::Counter>(i)) == 0,
+            "Expected counters to be compiled out");
+  }
+#endif
+
+  return 0;
+}
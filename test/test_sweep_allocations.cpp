@@ -0,0 +1,85 @@
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+#include <order_book.h>
+#include <order.h>
+#include <result_sink.h>
+#include "test_utils.h"
+
+static size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+  ++allocations;
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+/**
+ * Rests one order on each of kLevels ask levels.
+*/
+static constexpr size_t kLevels = 50;
+
+static void rest_asks(order::BookMap *books, order::oid_t first,
+                      order::OrderResult *result)
+{
+  for (size_t i = 0; i < kLevels; ++i) {
+    order::Order sell{first + static_cast<order::oid_t>(i), 0,
+                      order::OrderSide::kSell, 10,
+                      (100 + static_cast<order::price_t>(i)) *
+                          order::kPriceScale};
+    books->handle_order(&sell, result);
+  }
+}
+
+/**
+ * test_sweep_allocations:
+ * 1. Rests 50 ask levels and sweeps them with one buy, to warm up the
+ *    book (levels, OID index, arena) and the output buffer.
+ * 2. Rests them again and checks that sweeping and formatting all 50
+ *    fills, with an OrderResult that reserved kReservedFills, doesn't
+ *    allocate.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  order::BookMap books;
+  books.symbols().intern("IBM");
+  order::OrderResult result{};
+  result.fills.reserve(order::kReservedFills);
+  order::OutputBuffer out;
+  order::BufferSink sink(&out);
+  // Keeps the book alive between the two sweeps.
+  order::Order anchor{1000, 0, order::OrderSide::kBuy, 1, order::kPriceScale};
+  books.handle_order(&anchor, &result);
+
+  for (int round = 0; round < 2; ++round) {
+    rest_asks(&books, 1, &result);
+    order::Order buy{500, 0, order::OrderSide::kBuy,
+                     static_cast<order::qty_t>(10 * kLevels),
+                     (100 + static_cast<order::price_t>(kLevels)) *
+                         order::kPriceScale};
+    out.clear();
+    auto before = allocations;
+    books.handle_order(&buy, &result);
+    result.serialize(books.symbols(), &sink);
+    auto swept = allocations - before;
+    ostream << "round " << round << ": " << result.fills.size()
+            << " fills, " << swept << " allocations\n";
+    assertm(result.fills.size() == kLevels, "Expected one fill per level");
+    if (round == 1) {
+      assertm(swept == 0, "Expected a warm sweep not to allocate");
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,90 @@
+#include <cstddef>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <order.h>
+#include <symbol_map.h>
+#include <symbol_table.h>
+#include "test_utils.h"
+
+/**
+ * test_symbol_map:
+ * 1. Checks that pack_symbol keeps every char of a symbol, so symbols that
+ *    differ anywhere get different keys.
+ * 2. Inserts 100k seeded random symbols into a FlatSymbolMap next to a
+ *    std::unordered_map, checking every one of them after each time the
+ *    table grows, and that symbols that were never inserted miss.
+ * 3. Checks that a SymbolTable refuses symbols longer than kMaxSymbolSize
+ *    and finds none of them.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  assertm(order::pack_symbol("IBM") == order::pack_symbol("IBM"),
+          "Expected equal keys");
+  assertm(order::pack_symbol("IBM") != order::pack_symbol("IBN"),
+          "Expected the last char to count");
+  assertm(order::pack_symbol("ABCDEFGH") != order::pack_symbol("ABCDEFGI"),
+          "Expected the eighth char to count");
+  assertm(order::pack_symbol("A") != order::pack_symbol("AA"),
+          "Expected the length to count");
+
+  std::mt19937 gen(24);
+  const std::string alnum =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+  auto random_symbol = [&] {
+    std::string symbol(1 + gen() % 8, ' ');
+    for (auto &c : symbol) {
+      c = alnum[gen() % alnum.size()];
+    }
+    return symbol;
+  };
+  order::FlatSymbolMap map;
+  std::unordered_map<std::string, order::symbol_id_t> expected;
+  size_t growths = 0;
+  while (expected.size() < 100000) {
+    auto symbol = random_symbol();
+    auto key = order::pack_symbol(symbol);
+    auto it = expected.find(symbol);
+    if (it != expected.end()) {
+      assertm(map.find(key) == it->second, "Expected a hit");
+      continue;
+    }
+    assertm(map.find(key) == order::kInvalidSymbol, "Expected a miss");
+    auto id = static_cast<order::symbol_id_t>(expected.size());
+    auto capacity = map.capacity();
+    map.insert(key, id);
+    expected.emplace(symbol, id);
+    if (map.capacity() != capacity) {
+      ++growths;
+      for (const auto &[name, name_id] : expected) {
+        assertm(map.find(order::pack_symbol(name)) == name_id,
+                "Expected every symbol to survive a rehash");
+      }
+    }
+  }
+  ostream << "symbols " << map.size() << " capacity " << map.capacity()
+          << " growths " << growths << '\n';
+  assertm(map.size() == expected.size(), "Expected every symbol");
+  assertm(map.size() * 8 <= map.capacity() * 7, "Expected 7/8 at most");
+
+  order::SymbolTable table;
+  table.intern("ABCDEFGH");
+  assertm(table.find("ABCDEFGHI") == order::kInvalidSymbol,
+          "Expected a long symbol to miss");
+  bool threw = false;
+  try {
+    table.intern("ABCDEFGHI");
+  } catch (const std::length_error &) {
+    threw = true;
+  }
+  assertm(threw, "Expected a long symbol to be refused");
+  assertm(table.size() == 1, "Expected nothing interned");
+
+  return 0;
+}
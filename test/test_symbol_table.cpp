@@ -0,0 +1,78 @@
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <order_book.h>
+#include <order.h>
+#include <symbol_table.h>
+#include "test_utils.h"
+
+/**
+ * test_symbol_table:
+ * 1. Interns a few symbols and checks that ids are dense and stable.
+ * 2. Places orders on two symbols through a BookMap and checks that
+ *    each book is reached by its id, and by name through get_spread.
+ * 3. Drains one book and checks that its id stays valid for new orders.
+ * 4. Checks that orders on ids the table never issued are rejected
+ *    without a book being made for them.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  order::SymbolTable table{};
+  assertm(table.find("IBM") == order::kInvalidSymbol, "Expected a miss");
+  assertm(table.intern("IBM") == 0, "Expected the first id");
+  assertm(table.intern("AAPL") == 1, "Expected the next id");
+  assertm(table.intern("IBM") == 0, "Expected the same id again");
+  assertm(table.find("AAPL") == 1, "Expected a hit");
+  assertm(table.name(1) == "AAPL", "Expected the interned name");
+  assertm(table.size() == 2, "Expected two symbols");
+
+  const order::price_t unit = order::kPriceScale;
+  using spread_t = std::pair<order::price_t, order::price_t>;
+  order::BookMap books{};
+  auto ibm = books.symbols().intern("IBM");
+  auto msft = books.symbols().intern("MSFT");
+  order::Order bid{0, ibm, order::OrderSide::kBuy, 10, 99 * unit};
+  order::Order ask{1, msft, order::OrderSide::kSell, 10, 101 * unit};
+  books.handle_order(&bid);
+  books.handle_order(&ask);
+  assertm(books.get_spread("IBM") == spread_t(99 * unit, 0),
+          "Expected only a bid on IBM");
+  assertm(books.get_spread("MSFT") == spread_t(0, 101 * unit),
+          "Expected only an ask on MSFT");
+  assertm(books.get_spread("AAPL") == spread_t(0, 0),
+          "Expected no book for an unknown symbol");
+
+  auto cancelled = books.cancel_order(0);
+  assertm(cancelled.type == order::ResultType::kCancelled,
+          "Expected the IBM bid to be cancelled");
+  assertm(books.get_spread("IBM") == spread_t(0, 0), "Expected an empty book");
+
+  order::Order sell{2, ibm, order::OrderSide::kSell, 5, 100 * unit};
+  auto result = books.handle_order(&sell);
+  assertm(result.fills.empty(), "Expected nothing to match");
+  assertm(books.get_spread("IBM") == spread_t(0, 100 * unit),
+          "Expected the drained book to come back");
+  assertm(books.serialize().size() == 2, "Expected one resting order each");
+
+  order::Order unset{3, order::kInvalidSymbol, order::OrderSide::kBuy, 10,
+                     99 * unit};
+  result = books.handle_order(&unset);
+  assertm(result.type == order::ResultType::kError &&
+              result.error == order::ErrorCode::kInvalidSymbol,
+          "Expected an order without a symbol to be rejected");
+  order::Order unissued{4, msft + 1, order::OrderSide::kBuy, 10, 99 * unit};
+  result = books.handle_order(&unissued);
+  assertm(result.type == order::ResultType::kError &&
+              result.error == order::ErrorCode::kInvalidSymbol,
+          "Expected an order on an unissued id to be rejected");
+  assertm(!books.contains(3) && !books.contains(4),
+          "Expected neither order to rest");
+  assertm(books.serialize().size() == 2, "Expected no new books");
+
+  return 0;
+}
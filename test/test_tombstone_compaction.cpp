@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <order_book.h>
+#include <order.h>
+#include "test_utils.h"
+
+/**
+ * test_tombstone_compaction:
+ * 1. Rests kNumOrders buys on one level and kills every one but each
+ *    tenth, checking that the FIFOs never hold more tombstones than
+ *    compaction allows (none for intrusive FIFOs).
+ * 2. Kills every survivor but each hundredth through the handles
+ *    place_order gave out before any compaction, so they still have to
+ *    find their orders afterwards, and that killed orders stay gone.
+ * 3. Sweeps the level and checks the remaining orders fill in FIFO order,
+ *    and that nothing is left.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  constexpr size_t kNumOrders = 5000;
+  constexpr order::qty_t kQty = 10;
+  auto orders = generate_dummy_n_orders(kNumOrders, 0, kQty);
+  order::OrderBook book;
+  order::OrderResult result;
+  for (auto &o : orders) {
+    book.place_order(&o, &result);
+  }
+
+  size_t live = kNumOrders;
+  size_t most_queued = 0;
+  for (size_t i = 0; i < kNumOrders; ++i) {
+    if (i % 10 != 0) {
+      assertm(book.kill_order(orders[i]), "Expected to kill the order");
+      --live;
+      auto tombstones = book.fifos_size() - live;
+      most_queued = std::max(most_queued, book.fifos_size());
+      if constexpr (levelmap::MaxLevelMap::kIntrusive) {
+        assertm(tombstones == 0, "Expected no tombstones");
+      } else {
+        assertm(tombstones <= std::max(levelmap::kCompactTombstones, live),
+                "Expected compaction to bound the tombstones");
+      }
+    }
+  }
+  ostream << "live " << live << " FIFOs " << book.fifos_size()
+          << " most queued " << most_queued << '\n';
+
+  for (size_t i = 0; i < kNumOrders; i += 10) {
+    if (i % 100 != 0) {
+      assertm(book.kill_order(orders[i]), "Expected a valid handle");
+      --live;
+    }
+    assertm(!book.kill_order(orders[i + 1]), "Expected it to stay gone");
+  }
+  assertm(book.order_count() == live * kQty, "Expected the survivors' qty");
+
+  order::Order sell{static_cast<order::oid_t>(kNumOrders), kDefaultSymbol,
+                    order::OrderSide::kSell,
+                    static_cast<order::qty_t>(live * kQty),
+                    orders.front().price};
+  book.place_order(&sell, &result);
+  assertm(result.fills.size() == live, "Expected every survivor to fill");
+  for (size_t f = 0; f < result.fills.size(); ++f) {
+    assertm(result.fills[f].resting == orders[f * 100].oid,
+            "Expected the survivors in FIFO order");
+  }
+  assertm(book.empty() && book.fifos_empty() && book.maps_empty(),
+          "Expected nothing left");
+
+  return 0;
+}
@@ -1,4 +1,6 @@
 #include <cstddef>
+#include <cstdio>
+#include <cstdlib>
 #include <order_book.h>
 #include <order.h>
 #include <vector>
@@ -6,18 +8,28 @@
 #include "test_utils.h"
 
 extern const order::qty_t kMaxQuantity;
-constexpr size_t kDefaultTestPrice = 100.0;
+const order::price_t kDefaultTestPrice = 100 * order::kPriceScale;
 constexpr order::qty_t kDefaultOrderQty = 10;
+constexpr order::symbol_id_t kDefaultSymbol = 0;
+
+void check_failed(const char *file, int line, const char *exp,
+                  const char *msg)
+{
+  std::fprintf(stderr, "%s:%d: check failed: %s (%s)\n", file, line, msg,
+               exp);
+  std::abort();
+}
 
 order::Order generate_dummy_order(order::oid_t oid, order::qty_t qty,
-                                  order::OrderSide side, order::symbol_t symbol)
+                                  order::OrderSide side,
+                                  order::symbol_id_t symbol)
 {
   return order::Order{oid, symbol, side, qty, kDefaultTestPrice};
 }
 
 std::vector<order::Order> generate_dummy_n_orders(size_t n, order::oid_t start,
                                                   order::qty_t qty,
-                                                  order::symbol_t symbol)
+                                                  order::symbol_id_t symbol)
 {
   std::vector<order::Order> result;
   result.resize(n);
@@ -36,31 +48,31 @@ std::vector<order::Order> generate_asc_desc_full_fills(size_t n,
                                                        order::oid_t start,
                                                        order::qty_t qty)
 {
-  assert(n % 2 == 0);
+  assertm(n % 2 == 0, "Expected an even number of orders");
   std::vector<order::Order> result;
   result.resize(n);
   order::oid_t count = start;
-  order::price_t curr_price{1.0};
+  order::price_t curr_price{order::kPriceScale};
 
   size_t i = 0;
   for (; i < n / 2; ++i) {
     result[i].oid = count++;
     result[i].side = order::OrderSide::kBuy;
-    result[i].symbol = "IBM";
+    result[i].symbol = kDefaultSymbol;
     result[i].qty = qty;
     result[i].price = curr_price;
-    curr_price += 1.0;
+    curr_price += order::kPriceScale;
   }
 
-  curr_price -= 1.0;
+  curr_price -= order::kPriceScale;
 
   for (; i < n; ++i) {
     result[i].oid = count++;
     result[i].side = order::OrderSide::kSell;
-    result[i].symbol = "IBM";
+    result[i].symbol = kDefaultSymbol;
     result[i].qty = qty;
     result[i].price = curr_price;
-    curr_price -= 1.0;
+    curr_price -= order::kPriceScale;
   }
 
   return result;
@@ -70,29 +82,29 @@ std::vector<order::Order> generate_asc_asc_full_fills(size_t n,
                                                       order::oid_t start,
                                                       order::qty_t qty)
 {
-  assert(n % 2 == 0);
+  assertm(n % 2 == 0, "Expected an even number of orders");
   std::vector<order::Order> result;
   result.resize(n);
   order::oid_t count = start;
-  order::price_t curr_price{1.0};
+  order::price_t curr_price{order::kPriceScale};
 
   size_t i = 0;
   for (; i < n / 2; ++i) {
     result[i].oid = count++;
     result[i].side = order::OrderSide::kBuy;
-    result[i].symbol = "IBM";
+    result[i].symbol = kDefaultSymbol;
     result[i].qty = qty;
     result[i].price = curr_price;
-    curr_price += 1.0;
+    curr_price += order::kPriceScale;
   }
-  curr_price = 1.0;
+  curr_price = order::kPriceScale;
   for (; i < n; ++i) {
     result[i].oid = count++;
     result[i].side = order::OrderSide::kSell;
-    result[i].symbol = "IBM";
+    result[i].symbol = kDefaultSymbol;
     result[i].qty = qty;
     result[i].price = curr_price;
-    curr_price += 1.0;
+    curr_price += order::kPriceScale;
   }
 
   return result;
@@ -2,21 +2,33 @@
 #define TEST_TEST_GENERATORS_H_
 #include <vector>
 #include <string>
-#include <cassert>
 #include <numeric>
 #include <order.h>
 
-#define assertm(exp, msg) assert(((void)msg, exp))
+/**
+ * Like assert, but kept in Release (NDEBUG) builds, which is what CI
+ * tests: prints where exp failed and msg, then aborts.
+*/
+#define assertm(exp, msg)                                     \
+  do {                                                        \
+    if (!(exp)) {                                             \
+      check_failed(__FILE__, __LINE__, #exp, msg);            \
+    }                                                         \
+  } while (false)
+
+[[noreturn]] void check_failed(const char *file, int line, const char *exp,
+                               const char *msg);
 
 const extern order::qty_t kDefaultOrderQty;
+const extern order::symbol_id_t kDefaultSymbol;
 
 order::Order generate_dummy_order(
     order::oid_t oid, order::qty_t qty,
     order::OrderSide side = order::OrderSide::kBuy,
-    order::symbol_t symbol = "IBM");
+    order::symbol_id_t symbol = kDefaultSymbol);
 std::vector<order::Order> generate_dummy_n_orders(
     size_t n, order::oid_t start, order::qty_t qty = 10,
-    order::symbol_t symbol = "IBM");
+    order::symbol_id_t symbol = kDefaultSymbol);
 std::vector<order::Order> generate_asc_desc_full_fills(
     size_t n, order::oid_t start, order::qty_t qty = kDefaultOrderQty);
 std::vector<order::Order> generate_asc_asc_full_fills(
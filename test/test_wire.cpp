@@ -0,0 +1,151 @@
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <string>
+#include <variant>
+#include <order.h>
+#include <result_sink.h>
+#include <symbol_table.h>
+#include <simple_cross.h>
+#include <wire.h>
+#include "test_utils.h"
+
+static std::string encoded(const wire::Message &msg)
+{
+  std::string bytes(wire::kMessageSize, '\0');
+  wire::encode(msg, bytes.data());
+  return bytes;
+}
+
+/**
+ * test_wire:
+ * 1. Checks the little-endian layout of an encoded message.
+ * 2. Round trips text actions through encode_action and decode_action.
+ * 3. Checks that malformed messages decode to the right ErrorCode.
+ * 4. Replays binary results into a ListSink and compares them to the text
+ *    the engine prints for the same results.
+*/
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  std::string ofile = std::string(argv[0]) + ".log";
+  std::ofstream ostream(ofile, std::ios::out);
+
+  wire::Message msg{};
+  msg.type = 'O';
+  msg.side = 'B';
+  msg.qty = 0x0102;
+  msg.oid = 0x03040506;
+  std::memcpy(msg.symbol, "IBM", 3);
+  msg.price = 0x0708;
+  auto bytes = encoded(msg);
+  assertm(bytes.size() == 24, "Expected 24 byte messages");
+  assertm(bytes.substr(0, 8) == std::string("OB\x02\x01\x06\x05\x04\x03", 8),
+          "Expected a little-endian header");
+  assertm(bytes.substr(8, 8) == std::string("IBM\0\0\0\0\0", 8),
+          "Expected a NUL padded symbol");
+  assertm(bytes.substr(16) == std::string("\x08\x07\0\0\0\0\0\0", 8),
+          "Expected a little-endian price");
+
+  order::SymbolTable text_symbols{};
+  order::SymbolTable wire_symbols{};
+  results_t err;
+  order::ErrorCode error;
+  order::oid_t oid;
+  for (const char *line :
+       {"O 10001 IBM B 10 99.5", "X 10002", "P", "P IBM 3"}) {
+    auto action = deserialize_action(line, &err, &text_symbols);
+    assertm(wire::encode_action(action, text_symbols, &msg),
+            "Expected a message");
+    auto decoded = wire::decode_action(encoded(msg), &wire_symbols, &error,
+                                       &oid);
+    assertm(error == order::ErrorCode::kNone, "Expected a valid message");
+    assertm(decoded.index() == action.index(), "Expected the same action");
+  }
+  auto action = deserialize_action("O 10001 IBM B 10 99.5", &err,
+                                   &text_symbols);
+  wire::encode_action(action, text_symbols, &msg);
+  auto decoded =
+      wire::decode_action(encoded(msg), &wire_symbols, &error, &oid);
+  const auto &order = std::get<PlaceOrderAction>(decoded).order;
+  assertm(order.oid == 10001 && order.qty == 10 &&
+              order.side == order::OrderSide::kBuy &&
+              order.price == 995 * order::kPriceScale / 10 &&
+              wire_symbols.name(order.symbol) == "IBM",
+          "Expected the same order");
+  wire::Message print_msg;
+  action = deserialize_action("P AAPL 7", &err, &text_symbols);
+  wire::encode_action(action, text_symbols, &print_msg);
+  decoded =
+      wire::decode_action(encoded(print_msg), &wire_symbols, &error, &oid);
+  const auto &print = std::get<PrintAction>(decoded);
+  assertm(print.key == order::pack_symbol("AAPL") &&
+              print.symbol == wire_symbols.find("AAPL") && print.depth == 7,
+          "Expected the same print");
+  wire::Message bad_print{};
+  bad_print.type = 'P';
+  bad_print.qty = 1;
+  wire::decode_action(encoded(bad_print), &wire_symbols, &error, &oid);
+  assertm(error == order::ErrorCode::kInvalidSymbol,
+          "Expected a depth without a symbol to be rejected");
+
+  auto expect_error = [&](wire::Message bad, order::ErrorCode code) {
+    wire::decode_action(encoded(bad), &wire_symbols, &error, &oid);
+    return error == code && oid == bad.oid;
+  };
+  wire::Message bad = msg;
+  bad.type = 'K';
+  assertm(expect_error(bad, order::ErrorCode::kInvalidAction),
+          "Expected an invalid action");
+  bad = msg;
+  bad.symbol[4] = 'X';
+  assertm(expect_error(bad, order::ErrorCode::kInvalidSymbol),
+          "Expected padding after the symbol to be rejected");
+  bad = msg;
+  bad.side = 'Q';
+  assertm(expect_error(bad, order::ErrorCode::kInvalidSide),
+          "Expected an invalid side");
+  bad = msg;
+  bad.qty = 0;
+  assertm(expect_error(bad, order::ErrorCode::kInvalidQuantity),
+          "Expected an invalid quantity");
+  bad = msg;
+  bad.price = order::kMaxPrice + 1;
+  assertm(expect_error(bad, order::ErrorCode::kPriceOutOfRange),
+          "Expected an invalid price");
+  wire::decode_action("short", &wire_symbols, &error, &oid);
+  assertm(error == order::ErrorCode::kInvalidAction,
+          "Expected a short message to be rejected");
+
+  std::list<std::string> lines;
+  order::ListSink sink(&lines);
+  order::Order fill{7, 0, order::OrderSide::kSell, 5, 100 * order::kPriceScale};
+  wire::Message result{};
+  result.type = 'F';
+  result.oid = 7;
+  result.qty = 5;
+  std::memcpy(result.symbol, "ABCDEFGH", 8);
+  result.price = fill.price;
+  wire::replay_result(result, &sink);
+  result.type = 'P';
+  result.side = 'S';
+  wire::replay_result(result, &sink);
+  result = wire::Message{};
+  result.type = 'E';
+  result.side = static_cast<char>(order::ErrorCode::kInvalidOid);
+  result.oid = 7;
+  wire::replay_result(result, &sink);
+  order::OutputBuffer level_out;
+  wire::BinarySink level_sink(&level_out);
+  level_sink.level(order::LevelDepth{fill.price, 70000, 3,
+                                     order::OrderSide::kBuy},
+                   "IBM");
+  wire::replay_result(wire::decode(level_out.view().data()), &sink);
+  std::list<std::string> expected{
+      fill.str("ABCDEFGH", 'F', false), fill.str("ABCDEFGH", 'P'),
+      "E Invalid OID: 7", "L IBM B 70000 3 100.00000"};
+  assertm(lines == expected, "Expected the engine's text");
+
+  return 0;
+}
@@ -0,0 +1,116 @@
+#ifndef UTIL_SPSC_QUEUE_H_
+#define UTIL_SPSC_QUEUE_H_
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+
+/**
+ * Bounded single-producer/single-consumer ring.
+ *
+ * Exactly one thread may push and exactly one other thread may pop. Each
+ * side keeps a private copy of the other side's index and only reloads it
+ * when the ring looks full (or empty), so the shared indices are touched
+ * about once per lap instead of once per element. Capacity is rounded up
+ * to a power of two.
+ *
+ * A consumer with nothing to do can sleep in pop() instead of spinning.
+ * It raises sleeping_ before it waits on tail_, and a push that sees the
+ * flag wakes it: both sides store, then load the other's word, seq_cst,
+ * so at least one of them sees the other and no push is slept through.
+ * Pushes only pay for the futex wake while the consumer is asleep.
+*/
+template <typename T>
+class SpscQueue
+{
+ public:
+  explicit SpscQueue(size_t capacity)
+      : mask_(round_up(capacity) - 1), slots_(new T[mask_ + 1])
+  {
+  }
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  /**
+   * Producer only. Returns false if the ring is full.
+  */
+  bool try_push(T value)
+  {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ > mask_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ > mask_) {
+        return false;
+      }
+    }
+    slots_[tail & mask_] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_seq_cst)) {
+      tail_.notify_one();
+    }
+    return true;
+  }
+
+  /**
+   * Consumer only. Returns false if the ring is empty.
+  */
+  bool try_pop(T* value)
+  {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_) {
+        return false;
+      }
+    }
+    *value = std::move(slots_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Consumer only. Tries spins times, yielding in between, then sleeps
+   * until the producer pushes something.
+  */
+  void pop(T* value, size_t spins)
+  {
+    for (size_t i = 0; !try_pop(value); ++i) {
+      if (i < spins) {
+        std::this_thread::yield();
+        continue;
+      }
+      auto head = head_.load(std::memory_order_relaxed);
+      sleeping_.store(true, std::memory_order_seq_cst);
+      if (tail_.load(std::memory_order_seq_cst) == head) {
+        tail_.wait(head, std::memory_order_acquire);
+      }
+      sleeping_.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  size_t capacity() const noexcept { return mask_ + 1; }
+
+ private:
+  static size_t round_up(size_t capacity)
+  {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    return size;
+  }
+
+  const size_t mask_;
+  std::unique_ptr<T[]> slots_;
+  // Consumer side.
+  alignas(64) std::atomic<size_t> head_{0};
+  size_t tail_cache_ = 0;
+  // Producer side.
+  alignas(64) std::atomic<size_t> tail_{0};
+  size_t head_cache_ = 0;
+  // Consumer is (about to be) waiting in pop(), read by every push.
+  alignas(64) std::atomic<bool> sleeping_{false};
+};
+
+#endif  // UTIL_SPSC_QUEUE_H_
@@ -0,0 +1,313 @@
+#ifndef UTIL_STATS_H_
+#define UTIL_STATS_H_
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+/**
+ * Engine counters and per action latency histograms.
+ *
+ * Everything here is compiled out unless the build defines SC_STATS
+ * (cmake -DSC_STATS=ON): STATS_COUNT expands to nothing and ActionTimer
+ * is an empty class whose calls inline away.
+ *
+ * Each thread records into its own Stats, so recording is a plain
+ * load/add/store on memory nobody else writes, no locked instructions.
+ * dump() may run on any thread at any time and sums them up, the values
+ * are atomics only so that those reads aren't a data race.
+*/
+namespace stats
+{
+
+enum class Counter : uint8_t {
+  kFills,
+  kLevelsCreated,
+  kLevelsErased,
+  kTombstonesSkipped,
+  kTombstonesCompacted,
+  kOidMisses,
+  kCount,
+};
+
+enum class ActionType : uint8_t {
+  kPlace,
+  kCancel,
+  kPrint,
+  kError,
+  kCount,
+};
+
+enum class Phase : uint8_t {
+  kParse,
+  kMatch,
+  kFormat,
+  kTotal,
+  kCount,
+};
+
+constexpr size_t kCounters = static_cast<size_t>(Counter::kCount);
+constexpr size_t kActionTypes = static_cast<size_t>(ActionType::kCount);
+constexpr size_t kPhases = static_cast<size_t>(Phase::kCount);
+
+constexpr std::string_view kCounterNames[kCounters] = {
+    "fills", "levels_created", "levels_erased", "tombstones_skipped",
+    "tombstones_compacted", "oid_misses",
+};
+constexpr std::string_view kActionNames[kActionTypes] = {
+    "place", "cancel", "print", "error",
+};
+constexpr std::string_view kPhaseNames[kPhases] = {
+    "parse", "match", "format", "total",
+};
+
+/**
+ * Single writer add.
+*/
+inline void bump(std::atomic<uint64_t>* value, uint64_t n = 1)
+{
+  value->store(value->load(std::memory_order_relaxed) + n,
+               std::memory_order_relaxed);
+}
+
+/**
+ * HDR-style log-linear histogram of nanoseconds: every power of two is
+ * split into 2^kSubBits equal buckets, so a value is reported to within
+ * 1/16th of itself across the whole uint64_t range in under 8KiB.
+*/
+class Histogram
+{
+ public:
+  static constexpr unsigned kSubBits = 4;
+  static constexpr uint64_t kSubBuckets = uint64_t{1} << kSubBits;
+  static constexpr size_t kBuckets = (64 - kSubBits + 1) << kSubBits;
+
+  void record(uint64_t value) { bump(&counts_[bucket_of(value)]); }
+
+  /**
+   * Adds other's counts into this one.
+  */
+  void merge(const Histogram& other)
+  {
+    for (size_t i = 0; i < kBuckets; ++i) {
+      bump(&counts_[i], other.counts_[i].load(std::memory_order_relaxed));
+    }
+  }
+
+  uint64_t count() const
+  {
+    uint64_t total = 0;
+    for (const auto& count : counts_) {
+      total += count.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  /**
+   * The highest value that shares a bucket with the nearest rank sample
+   * for p, 0 if nothing was recorded.
+  */
+  uint64_t percentile(double p) const
+  {
+    auto total = count();
+    if (total == 0) {
+      return 0;
+    }
+    auto exact = p * static_cast<double>(total);
+    auto rank = static_cast<uint64_t>(exact);
+    rank += (static_cast<double>(rank) < exact) ? 1 : 0;
+    rank = (rank == 0) ? 1 : (rank > total ? total : rank);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+      seen += counts_[i].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+        return highest_in(i);
+      }
+    }
+    return highest_in(kBuckets - 1);
+  }
+
+ private:
+  static size_t bucket_of(uint64_t value)
+  {
+    if (value < kSubBuckets) {
+      return value;
+    }
+    auto exponent = static_cast<unsigned>(std::bit_width(value)) - 1;
+    auto sub = (value >> (exponent - kSubBits)) & (kSubBuckets - 1);
+    return ((exponent - kSubBits + 1) << kSubBits) + sub;
+  }
+
+  static uint64_t highest_in(size_t bucket)
+  {
+    if (bucket < kSubBuckets) {
+      return bucket;
+    }
+    auto exponent = (bucket >> kSubBits) + kSubBits - 1;
+    auto sub = bucket & (kSubBuckets - 1);
+    auto shift = exponent - kSubBits;
+    auto low = (kSubBuckets + sub) << shift;
+    return low + ((uint64_t{1} << shift) - 1);
+  }
+
+  std::array<std::atomic<uint64_t>, kBuckets> counts_{};
+};
+
+struct Stats {
+  std::array<std::atomic<uint64_t>, kCounters> counters{};
+  Histogram latency[kActionTypes][kPhases];
+};
+
+/**
+ * Owns every thread's Stats. They are kept after their thread exits, so
+ * totals include threads that are gone, e.g. a finished ShardedCross.
+*/
+class Registry
+{
+ public:
+  static Registry& instance()
+  {
+    static Registry registry;
+    return registry;
+  }
+
+  Stats* attach()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.push_back(std::make_unique<Stats>());
+    return stats_.back().get();
+  }
+
+  /**
+   * Sum of every thread's Stats so far.
+  */
+  std::unique_ptr<Stats> total()
+  {
+    auto sum = std::make_unique<Stats>();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& stats : stats_) {
+      for (size_t i = 0; i < kCounters; ++i) {
+        bump(&sum->counters[i],
+             stats->counters[i].load(std::memory_order_relaxed));
+      }
+      for (size_t type = 0; type < kActionTypes; ++type) {
+        for (size_t phase = 0; phase < kPhases; ++phase) {
+          sum->latency[type][phase].merge(stats->latency[type][phase]);
+        }
+      }
+    }
+    return sum;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Stats>> stats_;
+};
+
+/**
+ * The calling thread's Stats.
+*/
+inline Stats& local()
+{
+  thread_local Stats* stats = Registry::instance().attach();
+  return *stats;
+}
+
+inline void count(Counter counter, uint64_t n = 1)
+{
+  bump(&local().counters[static_cast<size_t>(counter)], n);
+}
+
+/**
+ * Writes the counters, then count and p50/p99/p99.9/max nanoseconds for
+ * every action type and phase that saw any actions.
+*/
+inline void dump(std::ostream& out)
+{
+  auto total = Registry::instance().total();
+  for (size_t i = 0; i < kCounters; ++i) {
+    out << "stats " << kCounterNames[i] << ' '
+        << total->counters[i].load(std::memory_order_relaxed) << '\n';
+  }
+  for (size_t type = 0; type < kActionTypes; ++type) {
+    for (size_t phase = 0; phase < kPhases; ++phase) {
+      const auto& histogram = total->latency[type][phase];
+      if (histogram.count() == 0) {
+        continue;
+      }
+      out << "stats " << kActionNames[type] << '.' << kPhaseNames[phase]
+          << " count " << histogram.count() << " p50 "
+          << histogram.percentile(0.5) << " p99 "
+          << histogram.percentile(0.99) << " p99.9 "
+          << histogram.percentile(0.999) << " max "
+          << histogram.percentile(1.0) << " ns\n";
+    }
+  }
+}
+
+/**
+ * Times one action: lap() closes the phase that just ran, done() records
+ * the whole action under its type.
+*/
+class ActionTimer
+{
+ public:
+#ifdef SC_STATS
+  ActionTimer() : start_(clock::now()), last_(start_) {}
+
+  void lap(Phase phase)
+  {
+    auto now = clock::now();
+    laps_[static_cast<size_t>(phase)] += elapsed(last_, now);
+    lapped_ |= 1U << static_cast<unsigned>(phase);
+    last_ = now;
+  }
+
+  void done(ActionType type)
+  {
+    laps_[static_cast<size_t>(Phase::kTotal)] = elapsed(start_, last_);
+    lapped_ |= 1U << static_cast<unsigned>(Phase::kTotal);
+    auto& latency = local().latency[static_cast<size_t>(type)];
+    for (size_t phase = 0; phase < kPhases; ++phase) {
+      if (lapped_ & (1U << phase)) {
+        latency[phase].record(laps_[phase]);
+      }
+    }
+  }
+
+ private:
+  using clock = std::chrono::steady_clock;
+
+  static uint64_t elapsed(clock::time_point from, clock::time_point to)
+  {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(to - from)
+            .count());
+  }
+
+  clock::time_point start_;
+  clock::time_point last_;
+  std::array<uint64_t, kPhases> laps_{};
+  unsigned lapped_ = 0;
+#else
+  void lap(Phase) {}
+  void done(ActionType) {}
+#endif
+};
+
+}  // namespace stats
+
+#ifdef SC_STATS
+#define STATS_COUNT(counter, n) stats::count(stats::Counter::counter, n)
+#else
+#define STATS_COUNT(counter, n) ((void)0)
+#endif
+
+#endif  // UTIL_STATS_H_
@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include "wire.h"
+
+namespace wire
+{
+
+constexpr size_t kMessageSize = 24;
+
+template <typename T>
+static void store_le(T value, char* out)
+{
+  using U = std::make_unsigned_t<T>;
+  auto bits = static_cast<U>(value);
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    out[i] = static_cast<char>((bits >> (8 * i)) & 0xFFU);
+  }
+}
+
+template <typename T>
+static T load_le(const char* in)
+{
+  using U = std::make_unsigned_t<T>;
+  U bits = 0;
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    auto byte = static_cast<U>(static_cast<unsigned char>(in[i]));
+    bits = static_cast<U>(bits | (byte << (8 * i)));
+  }
+  return static_cast<T>(bits);
+}
+
+void encode(const Message& msg, char* out)
+{
+  out[0] = msg.type;
+  out[1] = msg.side;
+  store_le(msg.qty, out + 2);
+  store_le(msg.oid, out + 4);
+  std::memcpy(out + 8, msg.symbol, sizeof(msg.symbol));
+  store_le(msg.price, out + 16);
+}
+
+Message decode(const char* in)
+{
+  Message msg{};
+  msg.type = in[0];
+  msg.side = in[1];
+  msg.qty = load_le<order::qty_t>(in + 2);
+  msg.oid = load_le<order::oid_t>(in + 4);
+  std::memcpy(msg.symbol, in + 8, sizeof(msg.symbol));
+  msg.price = load_le<order::price_t>(in + 16);
+  return msg;
+}
+
+static std::string_view symbol_of(const Message& msg)
+{
+  return {msg.symbol, ::strnlen(msg.symbol, sizeof(msg.symbol))};
+}
+
+static void copy_symbol(std::string_view symbol, Message* msg)
+{
+  std::memcpy(msg->symbol, symbol.data(),
+              std::min(symbol.size(), sizeof(msg->symbol)));
+}
+
+/**
+ * 1 to kMaxSymbolSize alphanumerics, then nothing but NUL padding.
+*/
+static bool valid_symbol(const Message& msg)
+{
+  auto symbol = symbol_of(msg);
+  if (symbol.empty()) {
+    return false;
+  }
+  for (char c : symbol) {
+    if (!std::isalnum(static_cast<unsigned char>(c))) {
+      return false;
+    }
+  }
+  for (size_t i = symbol.size(); i < sizeof(msg.symbol); ++i) {
+    if (msg.symbol[i] != '\0') {
+      return false;
+    }
+  }
+  return true;
+}
+
+static Action decode_print(const Message& msg, order::SymbolTable* symbols,
+                           order::ErrorCode* error)
+{
+  PrintAction print;
+  if (msg.symbol[0] == '\0' && msg.qty == 0) {
+    return print;
+  }
+  if (!valid_symbol(msg)) {
+    *error = order::ErrorCode::kInvalidSymbol;
+    return NopAction{};
+  }
+  // Looked up only, like a text print.
+  print.key = order::pack_symbol(symbol_of(msg));
+  print.symbol = symbols->find(symbol_of(msg));
+  print.depth = msg.qty;
+  return print;
+}
+
+Action decode_action(std::string_view bytes, order::SymbolTable* symbols,
+                     order::ErrorCode* error, order::oid_t* oid)
+{
+  *error = order::ErrorCode::kNone;
+  if (bytes.size() != kMessageSize) {
+    *oid = 0;
+    *error = order::ErrorCode::kInvalidAction;
+    return NopAction{};
+  }
+  auto msg = decode(bytes.data());
+  *oid = msg.oid;
+  switch (msg.type) {
+    case 'P':
+      return decode_print(msg, symbols, error);
+    case 'X':
+      return CancelOrderAction{msg.oid};
+    case 'O':
+      break;
+    default:
+      *error = order::ErrorCode::kInvalidAction;
+      return NopAction{};
+  }
+  if (!valid_symbol(msg)) {
+    *error = order::ErrorCode::kInvalidSymbol;
+  } else if (msg.side != 'B' && msg.side != 'S') {
+    *error = order::ErrorCode::kInvalidSide;
+  } else if (msg.qty == 0) {
+    *error = order::ErrorCode::kInvalidQuantity;
+  } else if (msg.price <= 0 || msg.price > order::kMaxPrice) {
+    *error = order::ErrorCode::kPriceOutOfRange;
+  }
+  if (*error != order::ErrorCode::kNone) {
+    return NopAction{};
+  }
+  auto side =
+      (msg.side == 'B') ? order::OrderSide::kBuy : order::OrderSide::kSell;
+  return PlaceOrderAction{order::Order{
+      msg.oid, symbols->intern(symbol_of(msg)), side, msg.qty, msg.price}};
+}
+
+bool encode_action(const Action& action, const order::SymbolTable& symbols,
+                   Message* msg)
+{
+  *msg = Message{};
+  if (const auto* place = std::get_if<PlaceOrderAction>(&action)) {
+    const auto& order = place->order;
+    msg->type = 'O';
+    msg->side = static_cast<char>(order.side);
+    msg->qty = order.qty;
+    msg->oid = order.oid;
+    copy_symbol(symbols.name(order.symbol), msg);
+    msg->price = order.price;
+  } else if (const auto* cancel = std::get_if<CancelOrderAction>(&action)) {
+    msg->type = 'X';
+    msg->oid = cancel->oid;
+  } else if (const auto* print = std::get_if<PrintAction>(&action)) {
+    msg->type = 'P';
+    if (print->key != 0) {
+      static_assert(sizeof(print->key) == sizeof(msg->symbol));
+      std::memcpy(msg->symbol, &print->key, sizeof(msg->symbol));
+      msg->qty = print->depth;
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void replay_result(const Message& msg, order::ResultSink* sink)
+{
+  auto side =
+      (msg.side == 'S') ? order::OrderSide::kSell : order::OrderSide::kBuy;
+  order::Order order{msg.oid, order::kInvalidSymbol, side, msg.qty,
+                     msg.price};
+  switch (msg.type) {
+    case 'F':
+      sink->fill(order, symbol_of(msg));
+      break;
+    case 'X':
+      sink->cancel(msg.oid);
+      break;
+    case 'E':
+      sink->error(static_cast<order::ErrorCode>(msg.side), msg.oid);
+      break;
+    case 'P':
+      sink->book_order(order, symbol_of(msg));
+      break;
+    case 'L':
+      sink->level(order::LevelDepth{msg.price, msg.oid, msg.qty, side},
+                  symbol_of(msg));
+      break;
+    default:
+      break;
+  }
+}
+
+void put(const Message& msg, order::OutputBuffer* out)
+{
+  char bytes[kMessageSize];
+  encode(msg, bytes);
+  out->append({bytes, kMessageSize});
+  out->end_record();
+}
+
+void BinarySink::line(std::string_view text)
+{
+  (void)text;
+  error(order::ErrorCode::kInvalidAction, 0);
+}
+
+void BinarySink::fill(const order::Order& order, std::string_view symbol)
+{
+  Message msg{};
+  msg.type = 'F';
+  msg.qty = order.qty;
+  msg.oid = order.oid;
+  copy_symbol(symbol, &msg);
+  msg.price = order.price;
+  put(msg, out_);
+}
+
+void BinarySink::cancel(order::oid_t oid)
+{
+  Message msg{};
+  msg.type = 'X';
+  msg.oid = oid;
+  put(msg, out_);
+}
+
+void BinarySink::error(order::ErrorCode code, order::oid_t oid)
+{
+  Message msg{};
+  msg.type = 'E';
+  msg.side = static_cast<char>(code);
+  msg.oid = oid;
+  put(msg, out_);
+}
+
+void BinarySink::book_order(const order::Order& order,
+                            std::string_view symbol)
+{
+  Message msg{};
+  msg.type = 'P';
+  msg.side = static_cast<char>(order.side);
+  msg.qty = order.qty;
+  msg.oid = order.oid;
+  copy_symbol(symbol, &msg);
+  msg.price = order.price;
+  put(msg, out_);
+}
+
+void BinarySink::level(const order::LevelDepth& depth,
+                       std::string_view symbol)
+{
+  Message msg{};
+  msg.type = 'L';
+  msg.side = static_cast<char>(depth.side);
+  msg.qty = static_cast<order::qty_t>(
+      std::min<uint64_t>(depth.orders, order::kMaxQuantity));
+  msg.oid = static_cast<order::oid_t>(
+      std::min<uint64_t>(depth.qty, order::kMaxOID));
+  copy_symbol(symbol, &msg);
+  msg.price = depth.price;
+  put(msg, out_);
+}
+
+}  // namespace wire
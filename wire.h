@@ -0,0 +1,108 @@
+#ifndef WIRE_H_
+#define WIRE_H_
+
+#include <cstddef>
+#include <string_view>
+#include <order.h>
+#include <result_sink.h>
+#include <symbol_table.h>
+#include "simple_cross.h"
+
+namespace wire
+{
+
+const extern size_t kMessageSize;
+
+/**
+ * Binary order entry: one fixed-width, little-endian message per action.
+ *
+ *   offset  size  field
+ *        0     1  type    'O', 'X', or 'P'
+ *        1     1  side    'B' or 'S'                          (O)
+ *        2     2  qty     u16, depth for P                    (O, P)
+ *        4     4  oid     u32                                 (O, X)
+ *        8     8  symbol  alphanumeric, NUL padded            (O, P)
+ *       16     8  price   i64 ticks of 1/order::kPriceScale   (O)
+ *
+ * A P without a symbol prints every book, see PrintAction.
+ *
+ * Results go out in the same layout, one message per text output line:
+ *   'F' fill         oid, symbol, qty, price
+ *   'X' cancelled    oid
+ *   'E' error        side holds the order::ErrorCode, oid
+ *   'P' resting      oid, symbol, side, qty, price
+ *   'L' L2 level     symbol, side, price, the level's total qty in oid
+ *                    and its order count in qty (both saturate)
+ * Fields a type doesn't use are 0.
+*/
+struct Message {
+  char type;
+  char side;
+  order::qty_t qty;
+  order::oid_t oid;
+  char symbol[8];
+  order::price_t price;
+};
+
+/**
+ * out must have room for kMessageSize bytes.
+*/
+void encode(const Message& msg, char* out);
+/**
+ * in must hold kMessageSize bytes.
+*/
+Message decode(const char* in);
+/**
+ * Encodes msg as one record of out.
+*/
+void put(const Message& msg, order::OutputBuffer* out);
+
+/**
+ * Decodes and validates an action message, and interns the symbol of a
+ * valid order. A message that doesn't check out decodes to a NopAction and
+ * sets *error, with the offending OID in *oid.
+*/
+Action decode_action(std::string_view bytes, order::SymbolTable* symbols,
+                     order::ErrorCode* error, order::oid_t* oid);
+
+/**
+ * The message for a parsed action, NopAction has no message and returns
+ * false.
+*/
+bool encode_action(const Action& action, const order::SymbolTable& symbols,
+                   Message* msg);
+
+/**
+ * Hands a result message to sink the way the engine would have, e.g. to
+ * print binary results as text.
+*/
+void replay_result(const Message& msg, order::ResultSink* sink);
+
+/**
+ * Encodes results into an OutputBuffer.
+ * Binary input has no free-form text errors, a line() is recorded as an
+ * 'E' kInvalidAction for OID 0.
+*/
+class BinarySink : public order::ResultSink
+{
+ public:
+  explicit BinarySink(order::OutputBuffer* out) : out_(out) {}
+
+  void line(std::string_view text) override;
+  void fill(const order::Order& order, std::string_view symbol) override;
+  void cancel(order::oid_t oid) override;
+  void error(order::ErrorCode code, order::oid_t oid) override;
+  void book_order(const order::Order& order,
+                  std::string_view symbol) override;
+  void level(const order::LevelDepth& depth,
+             std::string_view symbol) override;
+
+  order::OutputBuffer* buffer() noexcept { return out_; }
+
+ private:
+  order::OutputBuffer* out_;
+};
+
+}  // namespace wire
+
+#endif  // WIRE_H_